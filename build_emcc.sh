@@ -4,6 +4,17 @@ set -xe
 
 cd docs
 
+# Only the font and the tile sprites are preloaded, the first frame waits
+# for them. Sounds and icons are downloaded by the game after the first
+# frame, from next to the page.
+PRELOAD="--preload-file ../assets/fonts@assets/fonts"
+for image in square_blank tile hovered_tile square_red flag mine; do
+    PRELOAD="$PRELOAD --preload-file ../assets/images/$image.png@assets/images/$image.png"
+done
+mkdir -p assets/images assets/sounds
+cp ../assets/images/icon_*.png assets/images/
+cp ../assets/sounds/*.wav assets/sounds/
+
 ### wasm compiling optimizations
 ## base:                     demo.wasm=3.0M, demo.js=393K
 ## -Os:                      demo.wasm=2.3M, demo.js=192K
@@ -11,13 +22,13 @@ cd docs
 ## disable harfbuz           demo.wasm=1.7M  demo.js=188K
 
 em++ ../src/anim.cpp ../src/color.cpp ../src/game.cpp ../src/texture.cpp \
-    ../src/button.cpp ../src/font.cpp ../src/main.cpp ../src/text.cpp ../src/tile.cpp \
+    ../src/button.cpp ../src/font.cpp ../src/main.cpp ../src/text.cpp ../src/tile.cpp ../src/clock.cpp ../src/profiler.cpp ../src/trace.cpp ../src/save.cpp ../src/minefield.cpp ../src/assets.cpp ../src/audio.cpp ../src/latency.cpp ../src/simulation.cpp \
     -Wall -o demo.js \
     -D RUNTIME_BASE_PATH="" \
     -Os -fno-exceptions -fno-rtti \
     --use-port=sdl2 --use-port=sdl2_image:formats=png --use-port=sdl2_mixer \
     --use-port=./emscripten_sdl2_ttf.py \
-    --preload-file ../assets@assets \
+    $PRELOAD \
     -sEXPORTED_FUNCTIONS=_main,_save,_onClick,_onAltClick --js-library mine.js \
     -sSTACK_SIZE=1000000 \
     "$@"
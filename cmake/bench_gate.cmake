@@ -0,0 +1,234 @@
+# Runs the benchmarks and compares them against a committed baseline.
+# Fails if a metric grew by more than its tolerance, printing a table of
+# every metric either way. With UPDATE=ON the baseline is rewritten from
+# this run instead, keeping the tolerances already in it.
+#
+# Timings are only gated on the machine and build the baseline was
+# recorded with, anywhere else they're shown and only the allocations
+# per frame are gated.
+#
+# cmake -DMINEBENCH=minebench -DTESTMINESECTOR=testminesector -DRUNTIME=<source dir>/
+#       -DBASELINE=tests/bench_baseline.json -DWORK_DIR=<dir> -DBUILD="<compiler> <build type>"
+#       [-DUPDATE=ON] -P cmake/bench_gate.cmake
+#
+# Baseline format, tolerances in percent of the baseline value:
+#   { "machine": "<cpu>, <build>",
+#     "metrics": { "<metric>": { "value": 123.4, "tolerance": 50 }, ... } }
+#
+# Needs CMake 3.19 for string(JSON)
+
+cmake_minimum_required(VERSION 3.19)
+
+foreach (VAR MINEBENCH TESTMINESECTOR RUNTIME BASELINE WORK_DIR BUILD)
+    if (NOT ${VAR})
+        message(FATAL_ERROR "${VAR} is required")
+    endif()
+endforeach()
+
+# Timings vary between runs, allocations per frame shouldn't
+set(DEFAULT_TOLERANCE_TIME 50)
+set(DEFAULT_TOLERANCE_ALLOCATIONS 10)
+
+# Rules benchmarks in the gate: generation, reveals and save I/O
+set(GATED_BENCHMARKS generateMines generateStartingArea flipOpening save load)
+set(BENCH_SECONDS 0.1)
+set(RENDER_FRAMES 120)
+
+cmake_host_system_information(RESULT CPU QUERY PROCESSOR_DESCRIPTION)
+string(STRIP "${CPU}" CPU)
+set(MACHINE "${CPU}, ${BUILD}")
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+set(BENCH_JSON "${WORK_DIR}/bench.json")
+set(RENDER_JSON "${WORK_DIR}/render_bench.json")
+
+execute_process(COMMAND "${MINEBENCH}" "${BENCH_JSON}" ${BENCH_SECONDS}
+                RESULT_VARIABLE RESULT OUTPUT_QUIET ERROR_QUIET)
+if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "minebench failed (${RESULT})")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E env "MINERUNTIME=${RUNTIME}" "${TESTMINESECTOR}" bench "${RENDER_JSON}" ${RENDER_FRAMES}
+                WORKING_DIRECTORY "${WORK_DIR}"
+                RESULT_VARIABLE RESULT OUTPUT_QUIET ERROR_QUIET)
+if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "testminesector bench failed (${RESULT})")
+endif()
+
+# Fixed point with 3 decimals, math(EXPR) only does integers
+function(to_milli VALUE OUT)
+    if (VALUE MATCHES "^([0-9]*)\\.?([0-9]*)$")
+        set(WHOLE "${CMAKE_MATCH_1}")
+        string(SUBSTRING "${CMAKE_MATCH_2}000" 0 3 FRACTION)
+        if (WHOLE STREQUAL "")
+            set(WHOLE 0)
+        endif()
+        string(REGEX REPLACE "^0+([0-9])" "\\1" FRACTION "${FRACTION}")
+        math(EXPR RESULT "${WHOLE} * 1000 + ${FRACTION}")
+        set(${OUT} ${RESULT} PARENT_SCOPE)
+    else()
+        message(FATAL_ERROR "Not a number: ${VALUE}")
+    endif()
+endfunction()
+
+function(from_milli VALUE OUT)
+    math(EXPR WHOLE "${VALUE} / 1000")
+    math(EXPR FRACTION "${VALUE} % 1000 + 1000")
+    string(SUBSTRING "${FRACTION}" 1 3 FRACTION)
+    set(${OUT} "${WHOLE}.${FRACTION}" PARENT_SCOPE)
+endfunction()
+
+# Collect this run's metrics as METRIC_<name> variables
+set(METRICS "")
+macro(add_metric NAME VALUE)
+    list(APPEND METRICS "${NAME}")
+    to_milli("${VALUE}" MILLI)
+    from_milli(${MILLI} "METRIC_${NAME}")
+endmacro()
+
+file(READ "${BENCH_JSON}" JSON)
+string(JSON COUNT LENGTH "${JSON}" benchmarks)
+math(EXPR LAST "${COUNT} - 1")
+foreach (I RANGE ${LAST})
+    string(JSON NAME GET "${JSON}" benchmarks ${I} name)
+    string(JSON BOARD GET "${JSON}" benchmarks ${I} board)
+    string(JSON MEDIAN GET "${JSON}" benchmarks ${I} median)
+    if (NAME IN_LIST GATED_BENCHMARKS)
+        add_metric("${NAME}/${BOARD}/ns" "${MEDIAN}")
+    endif()
+endforeach()
+
+file(READ "${RENDER_JSON}" JSON)
+string(JSON COUNT LENGTH "${JSON}" scenes)
+math(EXPR LAST "${COUNT} - 1")
+foreach (I RANGE ${LAST})
+    string(JSON SCENE GET "${JSON}" scenes ${I} name)
+    string(JSON P50 GET "${JSON}" scenes ${I} frame_ms p50)
+    string(JSON P90 GET "${JSON}" scenes ${I} frame_ms p90)
+    string(JSON ALLOCATIONS GET "${JSON}" scenes ${I} allocations)
+    add_metric("render/${SCENE}/frame_p50/ms" "${P50}")
+    add_metric("render/${SCENE}/frame_p90/ms" "${P90}")
+    add_metric("render/${SCENE}/allocations" "${ALLOCATIONS}")
+endforeach()
+
+set(BASELINE_JSON "{\"metrics\": {}}")
+if (EXISTS "${BASELINE}")
+    file(READ "${BASELINE}" BASELINE_JSON)
+endif()
+
+if (UPDATE)
+    set(OUT "{\n  \"machine\": \"${MACHINE}\",\n  \"metrics\": {\n")
+    set(SEPARATOR "")
+    foreach (NAME ${METRICS})
+        string(JSON TOLERANCE ERROR_VARIABLE MISSING GET "${BASELINE_JSON}" metrics "${NAME}" tolerance)
+        if (MISSING)
+            if (NAME MATCHES "allocations$")
+                set(TOLERANCE ${DEFAULT_TOLERANCE_ALLOCATIONS})
+            else()
+                set(TOLERANCE ${DEFAULT_TOLERANCE_TIME})
+            endif()
+        endif()
+        string(APPEND OUT "${SEPARATOR}    \"${NAME}\": { \"value\": ${METRIC_${NAME}}, \"tolerance\": ${TOLERANCE} }")
+        set(SEPARATOR ",\n")
+    endforeach()
+    string(APPEND OUT "\n  }\n}\n")
+    file(WRITE "${BASELINE}" "${OUT}")
+    message("Wrote ${BASELINE}")
+    return()
+endif()
+
+function(pad TEXT WIDTH OUT)
+    string(LENGTH "${TEXT}" LENGTH)
+    while (LENGTH LESS WIDTH)
+        string(APPEND TEXT " ")
+        math(EXPR LENGTH "${LENGTH} + 1")
+    endwhile()
+    set(${OUT} "${TEXT}" PARENT_SCOPE)
+endfunction()
+
+string(JSON BASELINE_MACHINE ERROR_VARIABLE NO_MACHINE GET "${BASELINE_JSON}" machine)
+if (NO_MACHINE)
+    set(BASELINE_MACHINE "an unknown machine")
+endif()
+if (BASELINE_MACHINE STREQUAL MACHINE)
+    set(GATE_TIMINGS ON)
+else()
+    set(GATE_TIMINGS OFF)
+    message("The baseline is from ${BASELINE_MACHINE}, this is ${MACHINE}. "
+            "Timings are shown but not gated, record a BENCH_BASELINE from the base commit "
+            "on this machine to gate them.")
+endif()
+
+set(TABLE "")
+set(FAILED "")
+pad("metric" 36 HEADER)
+string(APPEND TABLE "${HEADER}  baseline     current      change  limit  status\n")
+
+string(JSON COUNT LENGTH "${BASELINE_JSON}" metrics)
+set(BASELINE_NAMES "")
+if (COUNT GREATER 0)
+    math(EXPR LAST "${COUNT} - 1")
+    foreach (I RANGE ${LAST})
+        string(JSON NAME MEMBER "${BASELINE_JSON}" metrics ${I})
+        list(APPEND BASELINE_NAMES "${NAME}")
+    endforeach()
+endif()
+
+foreach (NAME ${BASELINE_NAMES})
+    string(JSON BASE GET "${BASELINE_JSON}" metrics "${NAME}" value)
+    to_milli("${BASE}" BASE_MILLI)
+    from_milli(${BASE_MILLI} BASE)
+    string(JSON TOLERANCE GET "${BASELINE_JSON}" metrics "${NAME}" tolerance)
+    pad("${NAME}" 36 ROW)
+
+    if (NOT DEFINED "METRIC_${NAME}")
+        pad("${BASE}" 12 BASE_TEXT)
+        string(APPEND TABLE "${ROW}  ${BASE_TEXT} -            -       ${TOLERANCE}%    MISSING\n")
+        list(APPEND FAILED "${NAME}")
+        continue()
+    endif()
+
+    set(CURRENT "${METRIC_${NAME}}")
+    to_milli("${CURRENT}" CURRENT_MILLI)
+    # Regressed if current > base * (1 + tolerance / 100)
+    math(EXPR LIMIT_MILLI "${BASE_MILLI} * (100 + ${TOLERANCE}) / 100")
+    if (BASE_MILLI GREATER 0)
+        math(EXPR CHANGE "(${CURRENT_MILLI} - ${BASE_MILLI}) * 100 / ${BASE_MILLI}")
+        set(CHANGE "${CHANGE}%")
+    elseif (CURRENT_MILLI GREATER 0)
+        set(CHANGE "new")
+    else()
+        set(CHANGE "0%")
+    endif()
+
+    if (NOT GATE_TIMINGS AND NOT NAME MATCHES "allocations$")
+        set(STATUS "not gated")
+    elseif (CURRENT_MILLI GREATER LIMIT_MILLI)
+        set(STATUS "REGRESSED")
+        list(APPEND FAILED "${NAME}")
+    else()
+        set(STATUS "ok")
+    endif()
+
+    pad("${BASE}" 12 BASE_TEXT)
+    pad("${CURRENT}" 12 CURRENT_TEXT)
+    pad("${CHANGE}" 7 CHANGE_TEXT)
+    pad("${TOLERANCE}%" 6 TOLERANCE_TEXT)
+    string(APPEND TABLE "${ROW}  ${BASE_TEXT} ${CURRENT_TEXT} ${CHANGE_TEXT} ${TOLERANCE_TEXT} ${STATUS}\n")
+endforeach()
+
+# Metrics the baseline doesn't know yet are shown but not gated
+foreach (NAME ${METRICS})
+    if (NOT NAME IN_LIST BASELINE_NAMES)
+        pad("${NAME}" 36 ROW)
+        pad("${METRIC_${NAME}}" 12 CURRENT_TEXT)
+        string(APPEND TABLE "${ROW}  -            ${CURRENT_TEXT} -       -      not in baseline\n")
+    endif()
+endforeach()
+
+message("${TABLE}")
+if (FAILED)
+    list(JOIN FAILED ", " FAILED)
+    message(FATAL_ERROR "Performance regressed: ${FAILED}")
+endif()
+message("No performance regressions")
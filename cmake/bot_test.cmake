@@ -0,0 +1,59 @@
+# Pipes a scripted session into minebot and compares the replies with the
+# expected ones. The whole script arrives at once, so it's answered as one
+# pipelined batch.
+#
+# cmake -DMINEBOT=minebot -DINPUT=tests/minebot.in -DEXPECTED=tests/minebot.expected
+#       [-DUPDATE=ON] -P cmake/bot_test.cmake
+#
+# With UPDATE=ON the expected replies are rewritten from this run instead.
+
+foreach (VAR MINEBOT INPUT EXPECTED)
+    if (NOT ${VAR})
+        message(FATAL_ERROR "${VAR} is required")
+    endif()
+endforeach()
+
+execute_process(COMMAND ${MINEBOT}
+    INPUT_FILE ${INPUT}
+    OUTPUT_VARIABLE ACTUAL
+    RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "minebot exited with ${RESULT}")
+endif()
+
+if (UPDATE)
+    file(WRITE ${EXPECTED} "${ACTUAL}")
+    message(STATUS "Wrote ${EXPECTED}")
+    return()
+endif()
+
+file(READ ${EXPECTED} WANTED)
+if (ACTUAL STREQUAL WANTED)
+    return()
+endif()
+
+string(REPLACE "\n" ";" ACTUAL_LINES "${ACTUAL}")
+string(REPLACE "\n" ";" WANTED_LINES "${WANTED}")
+list(LENGTH ACTUAL_LINES ACTUAL_COUNT)
+list(LENGTH WANTED_LINES WANTED_COUNT)
+set(LINE 0)
+while (LINE LESS ACTUAL_COUNT AND LINE LESS WANTED_COUNT)
+    list(GET ACTUAL_LINES ${LINE} GOT)
+    list(GET WANTED_LINES ${LINE} WANT)
+    if (NOT GOT STREQUAL WANT)
+        break()
+    endif()
+    math(EXPR LINE "${LINE} + 1")
+endwhile()
+math(EXPR REPLY "${LINE} + 1")
+if (LINE LESS ACTUAL_COUNT)
+    list(GET ACTUAL_LINES ${LINE} GOT)
+else()
+    set(GOT "<no reply>")
+endif()
+if (LINE LESS WANTED_COUNT)
+    list(GET WANTED_LINES ${LINE} WANT)
+else()
+    set(WANT "<no reply>")
+endif()
+message(FATAL_ERROR "Reply ${REPLY} differs\n  expected: ${WANT}\n  got:      ${GOT}")
@@ -0,0 +1,40 @@
+# Packs every file under ASSETS_DIR into one C++ source at OUTPUT.
+# The files are stored back to back in a single array with an index
+# sorted by path, for Assets::open to serve them from memory.
+#
+# cmake -DASSETS_DIR=assets -DOUTPUT=asset_pack.cpp -P cmake/pack_assets.cmake
+
+if (NOT ASSETS_DIR OR NOT OUTPUT)
+    message(FATAL_ERROR "ASSETS_DIR and OUTPUT are required")
+endif()
+
+get_filename_component(ASSETS_DIR "${ASSETS_DIR}" ABSOLUTE)
+get_filename_component(ASSETS_PARENT "${ASSETS_DIR}" DIRECTORY)
+
+file(GLOB_RECURSE FILES RELATIVE "${ASSETS_PARENT}" "${ASSETS_DIR}/*")
+list(SORT FILES)
+
+set(BLOB "")
+set(INDEX "")
+set(OFFSET 0)
+foreach (FILE ${FILES})
+    file(READ "${ASSETS_PARENT}/${FILE}" HEX HEX)
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR SIZE "${HEX_LENGTH} / 2")
+
+    # 32 bytes per line
+    string(REGEX REPLACE "([0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f])" "\\1\n" HEX "${HEX}")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," HEX "${HEX}")
+
+    string(APPEND BLOB "// ${FILE}\n${HEX}\n")
+    string(APPEND INDEX "    { \"${FILE}\", BLOB + ${OFFSET}, ${SIZE} },\n")
+    math(EXPR OFFSET "${OFFSET} + ${SIZE}")
+endforeach()
+
+list(LENGTH FILES COUNT)
+file(WRITE "${OUTPUT}"
+"// Generated by cmake/pack_assets.cmake, do not edit\n"
+"#include \"assets.h\"\n\n"
+"static const unsigned char BLOB[] = {\n${BLOB}};\n\n"
+"const Assets::PackEntry Assets::PACK[] = {\n${INDEX}};\n"
+"const size_t Assets::PACK_COUNT = ${COUNT};\n")
@@ -1,42 +1,100 @@
+// Saves are stored base64 encoded under "save64". Older builds stored one
+// character per byte under "save", which is still read.
 mergeInto(LibraryManager.library, {
     /**
      * @param {string} _path
      * @return {boolean}
      */
     openSaveReader: function(_path) {
-        /** @type {string} **/
-        let contents = localStorage.getItem("save");
-        if (contents) {
-            _reader = {index: 0, str: contents};
-            return true
+        /** @type {?string} **/
+        let encoded = localStorage.getItem("save64");
+        /** @type {?string} **/
+        let contents = encoded !== null ? atob(encoded) : localStorage.getItem("save");
+        if (!contents) {
+            return false;
         }
-        return false
+        let bytes = new Uint8Array(contents.length);
+        for (let i = 0; i < contents.length; i++) {
+            bytes[i] = contents.charCodeAt(i);
+        }
+        _reader = {index: 0, bytes: bytes};
+        return true;
     },
     /**
      * @return {number}
      */
     readByte: function() {
-        if (typeof _reader != "undefined") {
-            return _reader.str.charCodeAt(_reader.index++);
+        if (typeof _reader != "undefined" && _reader && _reader.index < _reader.bytes.length) {
+            return _reader.bytes[_reader.index++];
         }
         else {
             return 0;
         }
     },
+    /**
+     * @param {number} ptr
+     * @param {number} size
+     * @return {number}
+     */
+    readBytes: function(ptr, size) {
+        if (typeof _reader == "undefined" || !_reader) return 0;
+        let count = Math.min(size, _reader.bytes.length - _reader.index);
+        HEAPU8.set(_reader.bytes.subarray(_reader.index, _reader.index + count), ptr);
+        _reader.index += count;
+        return count;
+    },
     openSaveWriter: function() {
-        _writer = {str: ""};
+        _writer = {size: 0, bytes: new Uint8Array(1024)};
         return true;
     },
+    /**
+     * @param {number} value
+     * @return {number}
+     */
     writeByte: function(value) {
-        _writer.str += String.fromCharCode(value);
-        localStorage.setItem("save", _writer.str);
+        if (_writer.size == _writer.bytes.length) {
+            let grown = new Uint8Array(_writer.bytes.length * 2);
+            grown.set(_writer.bytes);
+            _writer.bytes = grown;
+        }
+        _writer.bytes[_writer.size++] = value;
         return 1;
     },
+    /**
+     * @param {number} ptr
+     * @param {number} size
+     * @return {number}
+     */
+    writeBytes: function(ptr, size) {
+        if (_writer.size + size > _writer.bytes.length) {
+            let grown = new Uint8Array(Math.max(_writer.bytes.length * 2, _writer.size + size));
+            grown.set(_writer.bytes.subarray(0, _writer.size));
+            _writer.bytes = grown;
+        }
+        _writer.bytes.set(HEAPU8.subarray(ptr, ptr + size), _writer.size);
+        _writer.size += size;
+        return size;
+    },
     closeSaveFile: function() {
+        // Commit the whole save with a single storage write
+        if (typeof _writer != "undefined" && _writer) {
+            let binary = "";
+            const CHUNK = 0x8000;
+            for (let i = 0; i < _writer.size; i += CHUNK) {
+                let end = Math.min(i + CHUNK, _writer.size);
+                binary += String.fromCharCode.apply(null, _writer.bytes.subarray(i, end));
+            }
+            localStorage.setItem("save64", btoa(binary));
+            localStorage.removeItem("save");
+        }
         _reader = null;
         _writer = null;
     },
     frontend_init: function() {
-        
+
+    },
+    frontend_update: function() {
+    },
+    frontend_quit: function() {
     },
 });
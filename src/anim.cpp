@@ -1,5 +1,6 @@
 #include "anim.h"
 #include <SDL.h>
+#include "profiler.h"
 
 namespace MineReveal {
     constexpr double DELTA_ALPHA = -1.0;
@@ -17,7 +18,7 @@ Anim& AnimState::play(int code, Anim* anim_, Uint32 delay) {
 
     active = code;
     started = false;
-    startTime = SDL_GetTicks() + delay;
+    startTime = Clock.ticks() + delay;
 
     return *anim;
 }
@@ -53,7 +54,7 @@ void AnimState::update(double dt) {
     if (!anim) return;
 
     if (!started) {
-        if (SDL_GetTicks() >= startTime) {
+        if (Clock.ticks() >= startTime) {
             started = true;
             anim->OnStart();
             if (anim->onstart) { anim->onstart(); }
@@ -66,8 +67,15 @@ void AnimState::update(double dt) {
 
 }
 
+void AnimState::render(double alpha) {
+    if (anim && started) {
+        anim->OnRender(alpha);
+    }
+}
+
 MineRevealAnim::MineRevealAnim(SDL_Point pos, int size) : pos(pos), size(size) {
     alpha = 1.0;
+    prevAlpha = alpha;
 }
 
 void MineRevealAnim::OnStart() {
@@ -76,13 +84,17 @@ void MineRevealAnim::OnStart() {
 bool MineRevealAnim::OnUpdate(double dt) {
     using namespace MineReveal;
 
-    SDL_SetRenderDrawColor(renderer, 0xFF, 0x00, 0x00, (int)(alpha*0xFF));
-    SDL_Rect fillrect { pos.x, pos.y, size, size };
-    SDL_RenderFillRect(renderer, &fillrect);
-
+    prevAlpha = alpha;
     alpha += DELTA_ALPHA * dt;
 
     return alpha > FINISHED_ALPHA;
 }
 
+void MineRevealAnim::OnRender(double t) {
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0x00, 0x00, (int)(lerp(prevAlpha, alpha, t)*0xFF));
+    SDL_Rect fillrect { pos.x, pos.y, size, size };
+    SDL_RenderFillRect(renderer, &fillrect);
+    Profiler.countDraw();
+}
+
 
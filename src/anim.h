@@ -3,6 +3,7 @@
 
 #include "texture.h"
 #include "color.h"
+#include "clock.h"
 #include <functional>
 #include <random>
 #include <memory>
@@ -15,7 +16,10 @@ public:
     virtual ~Anim() = default;
 
     virtual void OnStart() = 0;
+    // Advance by one simulation step, return false when finished
     virtual bool OnUpdate(double dt) = 0;
+    // Draw the current state, `alpha` interpolates between the last two steps
+    virtual void OnRender(double alpha) = 0;
 
     callback onstart{};
     callback onfinish{};
@@ -26,10 +30,11 @@ public:
     AnimState();
 
     void update(double dt);
+    void render(double alpha);
     Anim& play(int code, Anim* anim, Uint32 delay = 0);
     void kill();
     Uint32 runningTime() {
-        return SDL_GetTicks() - startTime;
+        return Clock.ticks() - startTime;
     }
 
     bool isAnimActive(int code);
@@ -51,14 +56,21 @@ public:
 
     void OnStart() override;
     bool OnUpdate(double dt) override;
+    void OnRender(double t) override;
 
 private:
     SDL_Point pos;
     int size;
 
     double alpha;
+    double prevAlpha;
 };
 
+// Linear interpolation between simulation steps
+inline double lerp(double a, double b, double t) {
+    return a + (b - a) * t;
+}
+
 
 
 #endif
@@ -3,8 +3,6 @@
 #include "SDL_render.h"
 #include <string>
 
-#define SECONDS() (SDL_GetTicks() * 0.001)
-
 extern SDL_Renderer *renderer;
 
 extern const int SCREEN_WIDTH;
@@ -19,6 +17,20 @@ public:
     void init();
     SDL_Window *window;
     std::string runtimeBasePath;
+
+    // Render with the software renderer into an offscreen surface,
+    // without a window or GPU. Set before init()
+    bool headless;
+    SDL_Surface *canvas;
+    // Don't draw or present frames at all, for replays that only check
+    // the game state
+    bool noRender;
+
+    // Present without vsync and pace frames in the main loop instead, so
+    // input is shown on the next present. Set by MINELOWLATENCY
+    bool lowLatency;
+    // Frames per second to pace at, the display's refresh rate if known
+    int refreshRate;
 };
 
 extern App Sim;
@@ -0,0 +1,128 @@
+#include "assets.h"
+#include <SDL_image.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "app.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+    // Decodes running at once, the rest wait in the queue
+    constexpr unsigned MAX_WORKERS = 4;
+
+    std::mutex jobsMutex;
+    std::deque<std::function<void()>> jobs;
+    unsigned workers = 0;
+
+    // Workers exit once the queue is empty, so none idle after loading
+    void work() {
+        std::unique_lock<std::mutex> lock(jobsMutex);
+        while (!jobs.empty()) {
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+        workers -= 1;
+    }
+
+    template <typename T>
+    std::future<T*> run(std::function<T*()> decode) {
+#ifdef __EMSCRIPTEN__
+        // Without pthreads the web build decodes when the result is requested
+        return std::async(std::launch::deferred, std::move(decode));
+#else
+        auto task = std::make_shared<std::packaged_task<T*()>>(std::move(decode));
+        std::future<T*> result = task->get_future();
+
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        jobs.emplace_back([task]() { (*task)(); });
+        if (workers < std::min(MAX_WORKERS, std::max(1u, std::thread::hardware_concurrency()))) {
+            workers += 1;
+            std::thread(work).detach();
+        }
+        return result;
+#endif
+    }
+}
+
+SDL_RWops *Assets::open(const std::string& path) {
+#ifdef EMBED_ASSETS
+    const PackEntry *end = PACK + PACK_COUNT;
+    const PackEntry *entry = std::lower_bound(PACK, end, path.c_str(), [](const PackEntry& e, const char *p) {
+        return strcmp(e.path, p) < 0;
+    });
+    if (entry != end && path == entry->path) {
+        return SDL_RWFromConstMem(entry->data, (int)entry->size);
+    }
+#endif
+    return SDL_RWFromFile((Sim.runtimeBasePath + path).c_str(), "rb");
+}
+
+#ifdef __EMSCRIPTEN__
+struct Fetch {
+    std::string path;
+    std::function<void(bool)> done;
+};
+
+static void onFetched(unsigned handle, void *arg, const char *file) {
+    (void)handle;
+    (void)file;
+    Fetch *fetch = static_cast<Fetch*>(arg);
+    fetch->done(true);
+    delete fetch;
+}
+
+static void onFetchFailed(unsigned handle, void *arg, int status) {
+    (void)handle;
+    Fetch *fetch = static_cast<Fetch*>(arg);
+    fprintf(stderr, "Unable to download %s (HTTP %d)\n", fetch->path.c_str(), status);
+    fetch->done(false);
+    delete fetch;
+}
+
+void Assets::fetch(const std::string& path, std::function<void(bool)> done) {
+    const std::string file = Sim.runtimeBasePath + path;
+    // The download is written to `file`, its directories have to exist
+    for (size_t slash = file.find('/', 1); slash != std::string::npos; slash = file.find('/', slash + 1)) {
+        mkdir(file.substr(0, slash).c_str(), 0755);
+    }
+    // Relative to the page, like the preloaded assets
+    emscripten_async_wget2(path.c_str(), file.c_str(), "GET", "", new Fetch { path, std::move(done) },
+                           onFetched, onFetchFailed, nullptr);
+}
+#else
+void Assets::fetch(const std::string& path, std::function<void(bool)> done) {
+    (void)path;
+    done(true);
+}
+#endif
+
+std::future<SDL_Surface*> Assets::decodeImage(const std::string& path) {
+    return run<SDL_Surface>([path]() {
+        SDL_Surface *surface = IMG_Load_RW(open(path), 1);
+        if (surface == nullptr) {
+            fprintf(stderr, "Unable to load image %s. SDL_image error: %s\n", path.c_str(), IMG_GetError());
+        }
+        return surface;
+    });
+}
+
+std::future<Mix_Chunk*> Assets::decodeSound(const std::string& path) {
+    return run<Mix_Chunk>([path]() {
+        Mix_Chunk *chunk = Mix_LoadWAV_RW(open(path), 1);
+        if (chunk == nullptr) {
+            fprintf(stderr, "Failed to load sound %s: %s\n", path.c_str(), Mix_GetError());
+        }
+        return chunk;
+    });
+}
@@ -0,0 +1,45 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <SDL_rwops.h>
+#include <SDL_surface.h>
+#include <SDL_mixer.h>
+#include <functional>
+#include <future>
+#include <string>
+
+// Paths are relative to the runtime path, like "assets/images/tile.png".
+// Builds with EMBED_ASSETS read them from a pack linked into the binary,
+// generated from assets/ by cmake/pack_assets.cmake.
+namespace Assets {
+    struct PackEntry {
+        const char *path;
+        const unsigned char *data;
+        size_t size;
+    };
+
+    // Sorted by path, defined in the generated asset_pack.cpp when built
+    // with EMBED_ASSETS
+    extern const PackEntry PACK[];
+    extern const size_t PACK_COUNT;
+
+    // Open an asset for reading, from the pack if it's in there and from
+    // the runtime path otherwise. Returns nullptr if it doesn't exist.
+    SDL_RWops *open(const std::string& path);
+
+    // Make sure an asset can be opened. The web build only preloads what
+    // the first frame needs and downloads the rest from next to the page
+    // into its in-memory file system. `done` gets whether it worked and
+    // runs on the main thread, on the web once the download finished and
+    // right away everywhere else.
+    void fetch(const std::string& path, std::function<void(bool)> done);
+
+    // Decode on a few worker threads. Failures are reported and give nullptr.
+    // Textures still have to be created from the surfaces on the render thread.
+    std::future<SDL_Surface*> decodeImage(const std::string& path);
+
+    // The mixer must be open, chunks are converted to its format
+    std::future<Mix_Chunk*> decodeSound(const std::string& path);
+}
+
+#endif
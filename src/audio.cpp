@@ -0,0 +1,99 @@
+#include "audio.h"
+#include <SDL_timer.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+static bool opened = false;
+static int samples = Audio::DEFAULT_BUFFER;
+static int frequency = Audio::FREQUENCY;
+
+// Timestamp of this frame's click, set from mainloop. play() turns it into
+// pendingStart, which postMix reads on the audio thread
+static std::atomic<Uint32> lastInput { 0 };
+// SDL_GetTicks when a sound was requested, 0 once measured
+static std::atomic<Uint32> pendingStart { 0 };
+static std::atomic<int> measured { -1 };
+
+// Runs on the audio thread after every mixed buffer. A sound requested
+// before this call is in this buffer, and is heard once the device has
+// played through it.
+static void postMix(void *udata, Uint8 *stream, int len) {
+    (void)udata;
+    (void)stream;
+    (void)len;
+    const Uint32 start = pendingStart.exchange(0);
+    if (start) {
+        const int bufferMs = samples * 1000 / frequency;
+        measured = int(SDL_GetTicks() - start) + bufferMs;
+    }
+}
+
+void Audio::open(bool lowLatency) {
+    // A small buffer can crackle on slow machines, only worth it when asked for
+    samples = lowLatency ? LOW_LATENCY_BUFFER : DEFAULT_BUFFER;
+    const char *env_buffer = std::getenv("MINEAUDIOBUFFER");
+    if (env_buffer && std::atoi(env_buffer) > 0) {
+        samples = std::atoi(env_buffer);
+    }
+
+    if (Mix_OpenAudio(FREQUENCY, MIX_DEFAULT_FORMAT, /* Channels */ 2, samples) < 0) {
+        fprintf(stderr, "SDL_mixer count not initialize: %s", Mix_GetError());
+        exit(1);
+    }
+
+    Uint16 format;
+    int channels;
+    Mix_QuerySpec(&frequency, &format, &channels);
+    printf("Audio: %d Hz, %d sample buffer\n", frequency, samples);
+
+    Mix_SetPostMix(postMix, nullptr);
+    opened = true;
+}
+
+bool Audio::isOpen() {
+    return opened;
+}
+
+void Audio::reserveChannels(int count, const float *volumes) {
+    if (!opened) return;
+    const int total = count * CHANNELS_PER_EFFECT;
+    Mix_AllocateChannels(total);
+    Mix_ReserveChannels(total);
+    for (int i = 0; i < count; ++i) {
+        const int first = i * CHANNELS_PER_EFFECT;
+        Mix_GroupChannels(first, first + CHANNELS_PER_EFFECT - 1, i);
+        for (int channel = first; channel < first + CHANNELS_PER_EFFECT; ++channel) {
+            Mix_Volume(channel, int(MIX_MAX_VOLUME * volumes[i]));
+        }
+    }
+}
+
+void Audio::play(int effect, Mix_Chunk *chunk) {
+    if (!opened) return;
+    int channel = Mix_GroupAvailable(effect);
+    if (channel == -1) {
+        channel = Mix_GroupOldest(effect);
+    }
+
+    // Measure from the click if there was one this frame
+    const Uint32 now = SDL_GetTicks();
+    const Uint32 input = lastInput.exchange(0);
+    const Uint32 start = input ? input : now;
+
+    if (Mix_PlayChannel(channel, chunk, 0) != -1) {
+        pendingStart = start ? start : 1;
+    }
+}
+
+void Audio::noteInput(Uint32 timestamp) {
+    lastInput = timestamp;
+}
+
+double Audio::latency() {
+    return measured;
+}
+
+int Audio::bufferSamples() {
+    return samples;
+}
@@ -0,0 +1,38 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <SDL_mixer.h>
+
+// Mixer setup and sound playback, with a smaller buffer in low latency mode.
+// Every sound effect gets its own reserved channels with their volume set
+// once, so playing a sound is a single Mix_PlayChannel.
+namespace Audio {
+    // Samples per mixer buffer, override with MINEAUDIOBUFFER.
+    // 2048 samples at 44.1 kHz is about 46 ms, 512 about 12 ms
+    constexpr int DEFAULT_BUFFER = 2048;
+    constexpr int LOW_LATENCY_BUFFER = 512;
+    constexpr int FREQUENCY = 44100;
+    constexpr int CHANNELS_PER_EFFECT = 2;
+
+    // Replaces Mix_OpenAudio, exits on failure
+    // Without it, e.g. when headless, nothing is played
+    void open(bool lowLatency);
+    [[nodiscard]] bool isOpen();
+
+    // Reserve CHANNELS_PER_EFFECT channels for each of `count` effects,
+    // grouped under the effect's index
+    void reserveChannels(int count, const float *volumes);
+
+    // Play on the effect's channels, cutting off its oldest sound if they're all busy
+    void play(int effect, Mix_Chunk *chunk);
+
+    // Time (SDL_GetTicks) of the input event that may trigger the next sound
+    void noteInput(Uint32 timestamp);
+
+    // Last measured time from input to the sound leaving the mixer's
+    // buffer in milliseconds, or a negative value before the first sound
+    double latency();
+    [[nodiscard]] int bufferSamples();
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "autosave.h"
+#include "trace.h"
+#include <cstdio>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+// Held for the rename only, so a writer never waits on another's fsync
+static std::mutex renameMutex;
+
+#ifdef _WIN32
+bool writeFileAtomic(const std::string& path, const std::string& tmp, const Uint8 *data, size_t size,
+                     const std::function<bool()>& keep) {
+    FILE *file = fopen(tmp.c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "Error opening %s for writing\n", tmp.c_str());
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file) == size
+           && fflush(file) == 0
+           && _commit(_fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+
+    std::lock_guard<std::mutex> lock(renameMutex);
+    if (ok && keep && !keep()) {
+        remove(tmp.c_str());
+        return true;
+    }
+    if (!ok || !MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        fprintf(stderr, "Error writing %s\n", path.c_str());
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+#else
+bool writeFileAtomic(const std::string& path, const std::string& tmp, const Uint8 *data, size_t size,
+                     const std::function<bool()>& keep) {
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(tmp.c_str());
+        return false;
+    }
+    bool ok = true;
+    for (size_t done = 0; ok && done < size; ) {
+        ssize_t count = write(fd, data + done, size - done);
+        ok = count > 0;
+        if (ok) done += count;
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+
+    {
+        std::lock_guard<std::mutex> lock(renameMutex);
+        if (ok && keep && !keep()) {
+            unlink(tmp.c_str());
+            return true;
+        }
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            perror(path.c_str());
+            unlink(tmp.c_str());
+            return false;
+        }
+    }
+
+    // Make the rename itself durable
+    const size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int dirfd = open(dir.c_str(), O_RDONLY);
+    if (dirfd >= 0) {
+        fsync(dirfd);
+        close(dirfd);
+    }
+    return true;
+}
+#endif
+
+static bool operator==(const Save::Data& a, const Save::Data& b) {
+    return a.rows == b.rows && a.cols == b.cols && a.state == b.state
+        && a.seed == b.seed && a.tiles == b.tiles;
+}
+
+Autosaver::Autosaver() : pending(false), stopping(false), generation(0) {}
+
+Autosaver::~Autosaver() {
+    stop();
+}
+
+void Autosaver::start(const std::string& path_) {
+    path = path_;
+    stopping = false;
+    worker = std::thread(&Autosaver::run, this);
+}
+
+void Autosaver::submit(Save::Data snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        next = std::move(snapshot);
+        pending = true;
+    }
+    wake.notify_one();
+}
+
+void Autosaver::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = false;
+    generation += 1;
+    // The file is about to hold a different save
+    written = Save::Data();
+}
+
+void Autosaver::stop() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void Autosaver::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return pending || stopping; });
+        if (!pending) break;
+
+        Save::Data snapshot = std::move(next);
+        pending = false;
+        if (snapshot == written) continue;
+
+        const Uint64 started = generation;
+        lock.unlock();
+
+        std::vector<Uint8> bytes;
+        {
+            TRACE_SCOPE("Autosaver::encode");
+            bytes = Save::encode(snapshot);
+        }
+        bool kept = false;
+        {
+            TRACE_SCOPE("Autosaver::write");
+            writeFileAtomic(path, path + ".autosave.tmp", bytes.data(), bytes.size(), [&] {
+                std::lock_guard<std::mutex> guard(mutex);
+                return kept = generation == started;
+            });
+        }
+
+        lock.lock();
+        if (kept) written = std::move(snapshot);
+    }
+}
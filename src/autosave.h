@@ -0,0 +1,58 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <SDL_stdinc.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "save.h"
+
+// Replace `path` by writing to the temporary file `tmp`, syncing it to
+// disk and renaming it over the old file, so a crash leaves either the old
+// or the new save but never a partial one. Safe to call from any thread,
+// as long as concurrent writers of a path use different `tmp` files.
+// `keep` is asked right before the rename, under a lock every rename
+// takes, and the new file is thrown away if it returns false.
+bool writeFileAtomic(const std::string& path, const std::string& tmp, const Uint8 *data, size_t size,
+                     const std::function<bool()>& keep = nullptr);
+
+// Encodes and writes save snapshots on a worker thread.
+// The main thread only pays for taking the snapshot.
+class Autosaver {
+public:
+    Autosaver();
+    ~Autosaver();
+
+    void start(const std::string& path);
+
+    // Queue a snapshot to be written, replacing any that's still waiting.
+    // Snapshots equal to the last written one are skipped
+    void submit(Save::Data snapshot);
+
+    // Drop the queued snapshot, and the one being written unless it's
+    // already in place. Doesn't wait for the write, call it before saving
+    // on the main thread so an older autosave can't replace that save.
+    void cancel();
+
+    // Write out the queued snapshot and join the worker
+    void stop();
+
+private:
+    std::string path;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    bool pending;
+    bool stopping;
+    // Bumped by cancel(), a write started before it isn't renamed into place
+    Uint64 generation;
+    Save::Data next;
+    Save::Data written;
+
+    void run();
+};
+
+#endif
@@ -5,13 +5,31 @@ extern "C" {
 #endif
 #include <SDL_video.h>
 #include <SDL_stdinc.h>
+#include <SDL_surface.h>
 
+// Safe to call from any thread at any rate. They're queued and run in
+// order on the main thread after the next frame's input, except save on
+// the main thread, which runs the queue and saves right away.
 void save(void);
 void onClick(int x, int y);
 void onAltClick(int x, int y);
 void quit(void);
 
+// The rest are for the main thread only, e.g. from frontend_update
+
+// Redraw the current frame and copy the board area (caller frees)
+SDL_Surface *captureBoard(void);
+bool screenshot(void);
+
 #ifdef __cplusplus
 }
+
+#include "save.h"
+// Copy of the game state, for saving it off the main thread
+Save::Data snapshotGame(void);
+// Replace the game with a saved one, sized at most MAX_FIELD_SIZE - 1
+void restoreGame(const Save::Data& data);
+// Center of a tile in window coordinates, to click it
+SDL_Point tileCenter(int row, int col);
 #endif
 #endif // FRONTEND_H
@@ -1,5 +1,6 @@
 #include "button.h"
 #include "color.h"
+#include "profiler.h"
 
 Button::Button(Texture *tex) : background(tex), hidden(false) {
     hidden = false;
@@ -63,6 +64,7 @@ void TextButton::render(bool isActive) {
         text.getHeight() + 2 * borderWidth
     };
     SDL_RenderFillRect(renderer, &fillRect);
+    Profiler.countDraw();
     text.render();
 }
 
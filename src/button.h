@@ -13,6 +13,8 @@ public:
         background = nullptr;
     }
     virtual ~Button();
+    Button(Button&&) = default;
+    Button& operator=(Button&&) = default;
 
     const Texture* background;
 
@@ -49,6 +51,8 @@ class TextButton : public Button {
 public:
     TextButton(TTF_Font * font = nullptr, std::string string = "", Color color = {0.f, 0.f, 0.f});
     ~TextButton();
+    TextButton(TextButton&&) = default;
+    TextButton& operator=(TextButton&&) = default;
 
     void render(bool isSelected) override;
     void load();
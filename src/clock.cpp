@@ -0,0 +1,43 @@
+#include "clock.h"
+#include <SDL_timer.h>
+
+FrameClock Clock;
+
+FrameClock::FrameClock()
+    : frameTicks(0)
+    , simTime(0.0)
+    , accumulator(0.0)
+    , dt(0.0)
+    , virtualStep(0)
+{}
+
+void FrameClock::start() {
+    if (!isVirtual()) {
+        frameTicks = SDL_GetTicks();
+    }
+    accumulator = 0.0;
+    dt = 0.0;
+}
+
+void FrameClock::tick() {
+    const Uint32 last = frameTicks;
+    if (isVirtual()) {
+        frameTicks += virtualStep;
+    } else {
+        frameTicks = SDL_GetTicks();
+    }
+    dt = (frameTicks - last) / 1000.0;
+
+    accumulator += dt < MAX_FRAME_TIME ? dt : MAX_FRAME_TIME;
+}
+
+bool FrameClock::step() {
+    if (accumulator < SIM_STEP) return false;
+    accumulator -= SIM_STEP;
+    simTime += SIM_STEP;
+    return true;
+}
+
+void FrameClock::setVirtual(Uint32 step) {
+    virtualStep = step;
+}
@@ -0,0 +1,58 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <SDL_stdinc.h>
+
+// Animations are simulated in fixed steps of this many seconds,
+// independent of the display's refresh rate
+constexpr double SIM_STEP = 1.0 / 120.0;
+
+// Don't try to catch up on more than this many seconds in one frame
+constexpr double MAX_FRAME_TIME = 0.25;
+
+// Time source for everything that animates.
+// Sampled once per frame so every tile and animation in a frame agrees on
+// the current time. The frame time is consumed in fixed simulation steps
+// with step(); ticks() and seconds() report simulation time.
+// In virtual mode the frame time advances by a fixed amount per frame
+// instead of following the wall clock, so frames can be run back-to-back.
+class FrameClock {
+public:
+    FrameClock();
+
+    // Sync with the time source without accumulating any time
+    void start();
+
+    // Call once at the start of every frame
+    void tick();
+
+    // Consume one SIM_STEP of the time accumulated by tick()
+    // Returns false once the simulation has caught up with the frame
+    bool step();
+
+    // Advance by `step` milliseconds per tick instead of reading SDL_GetTicks
+    // Pass 0 to go back to real time
+    void setVirtual(Uint32 step);
+    [[nodiscard]] bool isVirtual() const { return virtualStep != 0; }
+
+    [[nodiscard]] Uint32 ticks() const { return Uint32(simTime * 1000.0); }
+    [[nodiscard]] double seconds() const { return simTime; }
+
+    // Seconds between the previous frame and this one
+    [[nodiscard]] double delta() const { return dt; }
+
+    // How far the frame is between the last two simulation steps [0, 1)
+    // Used to interpolate when rendering
+    [[nodiscard]] double alpha() const { return accumulator / SIM_STEP; }
+
+private:
+    Uint32 frameTicks;
+    double simTime;
+    double accumulator;
+    double dt;
+    Uint32 virtualStep;
+};
+
+extern FrameClock Clock;
+
+#endif
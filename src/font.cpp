@@ -1,12 +1,13 @@
 #include "font.h"
 #include "app.h"
+#include "assets.h"
 
 Font::Font() {
     font = nullptr;
 }
 
 void Font::load(std::string path, int size) {
-    font = TTF_OpenFont((Sim.runtimeBasePath + path).c_str(), size);
+    font = TTF_OpenFontRW(Assets::open(path), 1, size);
     if (font == nullptr) {
         fprintf(stderr, "Failed to load font! SDL_ttf error: %s\n", TTF_GetError());
         exit(1);
@@ -6,12 +6,23 @@ extern "C" {
 #include <SDL_video.h>
 #include <SDL_stdinc.h>
 #include <stdbool.h>
+#include <stddef.h>
+// Save I/O is buffered in memory. The reader loads the whole save when
+// opened and the writer only writes it out in closeSaveFile
 extern bool openSaveReader(void);
 extern Uint8 readByte(void);
+// Returns the number of bytes read, less than size at the end of the save
+extern size_t readBytes(Uint8 *data, size_t size);
 extern bool openSaveWriter(void);
 extern int writeByte(Uint8 value);
+// Returns the number of bytes written
+extern size_t writeBytes(const Uint8 *data, size_t size);
 extern void closeSaveFile(void);
 extern void frontend_init(char **arg);
+// Called once per frame from the main loop, after input is handled
+extern void frontend_update(void);
+// Called once after the main loop, before the final save
+extern void frontend_quit(void);
 
 #ifdef __cplusplus
 }
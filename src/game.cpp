@@ -9,6 +9,11 @@
 #include <assert.h>
 #include <cstring>
 #include "frontend.h"
+#include "profiler.h"
+#include "trace.h"
+#include "assets.h"
+#include "audio.h"
+#include "clock.h"
 
 namespace Detonation {
     namespace Particle {
@@ -61,13 +66,6 @@ namespace Detonation {
 
 constexpr int VERT_COUNT = 6;
 
-constexpr Uint32 MINE_REVEAL_MILLISECONDS = 5000;
-constexpr Uint32 FLIP_DELAY = 100;
-
-constexpr float PERCENT_MINES = 0.15;
-
-constexpr int STARTING_SAFE_COUNT = 15;
-
 constexpr double UI_COLOR_MOD = 0.3;
 
 namespace Difficulty {
@@ -106,13 +104,11 @@ static std::string OVERLAY_FILES[TileOverlay::COUNT] = {
 
 static bool muted = false;
 static void playSoundEffect(int effect) {
-    int channel = Mix_PlayChannel(-1, Game::sounds[effect], 0);
-    if (channel != -1) {
-        Mix_Volume(channel, int(MIX_MAX_VOLUME * SOUND_VOLUMES[effect]));
-    }
+    // Not downloaded yet on the web
+    if (Game::sounds[effect] == nullptr) return;
+    Audio::play(effect, Game::sounds[effect]);
 }
 
-const char Save::HEADER[] = "MINE ";
 const char *Save::FILE = "data.bin";
 
 struct Quad { int l, r, t, b; };
@@ -125,6 +121,8 @@ protected:
 
     float x;
     float y;
+    float prevX;
+    float prevY;
     
     double born;
 
@@ -133,16 +131,19 @@ protected:
 public:
     int depth;
     DetonationParticle(std::mt19937& rng, float x, float y, SDL_Rect &field)
-        : x(x), y(y), field(field)
+        : x(x), y(y), prevX(x), prevY(y), field(field)
     {
-        born = SECONDS();
+        born = Clock.seconds();
         using namespace Detonation::Particle;
         depth = std::uniform_int_distribution<>(Depth::MIN, Depth::MAX) (rng);
     }
     virtual ~DetonationParticle() = default;
 
-    virtual void render(double dt) = 0;
+    virtual void update(double dt) = 0;
+    virtual void render(double t) = 0;
     void updatePosition(double dt, Quad quad) {
+        prevX = x;
+        prevY = y;
         float nextx = x + dx * dt;
         float nexty = y + dy * dt;
         if ((nextx + quad.l < field.x) || (nextx + quad.r > field.x + field.w)) {
@@ -163,7 +164,7 @@ public:
     }
 
     [[nodiscard]] double age() const {
-        return SECONDS() - born;
+        return Clock.seconds() - born;
     }
 };
 
@@ -172,7 +173,8 @@ public:
     DestructionParticle(Texture &tex, std::mt19937& rng, int x, int y, SDL_Rect &field);
     ~DestructionParticle() override = default;
 
-    void render(double dt) override;
+    void update(double dt) override;
+    void render(double t) override;
 
 private:
     SDL_Point vertpos[VERT_COUNT];
@@ -202,22 +204,25 @@ public:
     }
     ~EmberParticle() override = default;
 
-    void render(double dt) override {
+    void update(double dt) override {
         using namespace Detonation::Particle;
 
         Quad bounds = {0, size, 0, size};
         updatePosition(dt, bounds);
 
         color.a += Ember::DELTA_ALPHA * dt;
+    }
 
+    void render(double t) override {
         color.draw();
         SDL_Rect fillrect;
         fillrect.w = size;
         fillrect.h = size;
-        fillrect.x = x;
-        fillrect.y = y;
+        fillrect.x = lerp(prevX, x, t);
+        fillrect.y = lerp(prevY, y, t);
 
         SDL_RenderFillRect(renderer, &fillrect);
+        Profiler.countDraw();
     }
 
 private:
@@ -232,6 +237,7 @@ public:
 
     void OnStart() override;
     bool OnUpdate(double  dt) override;
+    void OnRender(double t) override;
 
 private:
     SDL_Point pos;
@@ -255,7 +261,7 @@ DetonationAnim::DetonationAnim(Texture &tex, std::mt19937& rng, SDL_Point tilePo
 }
 
 void DetonationAnim::OnStart() {
-    startTime = SECONDS();
+    startTime = Clock.seconds();
 }
 
 void DetonationAnim::emitParticle(std::unique_ptr<DetonationParticle> part) {
@@ -273,7 +279,7 @@ void DetonationAnim::emitParticle(std::unique_ptr<DetonationParticle> part) {
 bool DetonationAnim::OnUpdate(double dt) {
     using namespace Detonation;
 
-    if (SECONDS() - startTime < Emitter::TIME) {
+    if (Clock.seconds() - startTime < Emitter::TIME) {
         if (particles.empty() || particles.back()->age() > Emitter::PERIOD) {
             for (int i = 0; i < Emitter::COUNT; ++i) {
                 //particles.emplace_back(tex, rng, pos.x, pos.y);
@@ -287,18 +293,28 @@ bool DetonationAnim::OnUpdate(double dt) {
         }
     }
 
-    bool rendering = false;
+    bool alive = false;
+    for (auto& particle : particles) {
+        if (!particle->isDead()) {
+            particle->update(dt);
+            alive = true;
+        }
+    }
+
+    return alive;
+}
+
+void DetonationAnim::OnRender(double t) {
+    using namespace Detonation;
+
     // Iterate through particles for each depth
     for (int i = 0; i < Particle::Depth::MAX; ++i) {
         for (auto& particle : particles) {
             if (particle->depth == i && !particle->isDead()) {
-                particle->render(dt);
-                rendering = true;
+                particle->render(t);
             }
         }
     }
-
-    return rendering;
 }
 
 DestructionParticle::DestructionParticle(Texture &tex, std::mt19937& rng, int x, int y, SDL_Rect &field)
@@ -307,7 +323,7 @@ DestructionParticle::DestructionParticle(Texture &tex, std::mt19937& rng, int x,
     using randreal = std::uniform_real_distribution<>;
     using namespace Detonation::Particle;
 
-    born = SECONDS();
+    born = Clock.seconds();
     float speedMin = Speed::MIN;
     float speedMax = Speed::MAX;
     dx = randreal( speedMin, speedMax) (rng);
@@ -343,7 +359,7 @@ DestructionParticle::DestructionParticle(Texture &tex, std::mt19937& rng, int x,
 
 }
 
-void DestructionParticle::render(double dt) {
+void DestructionParticle::update(double dt) {
     using namespace Detonation::Particle;
     updatePosition(dt, bounds);
 
@@ -353,7 +369,11 @@ void DestructionParticle::render(double dt) {
         dy = 0.0;
         dx = 0.0;
     }
+}
 
+void DestructionParticle::render(double t) {
+    const float drawX = lerp(prevX, x, t);
+    const float drawY = lerp(prevY, y, t);
 
     const SDL_FPoint quad[VERT_COUNT] = { {0, 0}, {1, 0}, {1, 1}, {1, 1}, {0, 1}, {0, 0} };
     const SDL_Color sdlcolor = color.as_sdl();
@@ -361,26 +381,20 @@ void DestructionParticle::render(double dt) {
 
     for (int i = 0; i < VERT_COUNT; ++i) {
         vert[i].color = sdlcolor;
-        vert[i].position.x = x + vertpos[i].x;
-        vert[i].position.y = y + vertpos[i].y;
+        vert[i].position.x = drawX + vertpos[i].x;
+        vert[i].position.y = drawY + vertpos[i].y;
         vert[i].tex_coord = quad[i];
     }
 
     SDL_RenderGeometry(renderer, tex.raw(), vert, VERT_COUNT, nullptr, 0);
+    Profiler.countDraw(tex.raw());
 }
 
 
 Mix_Chunk* Game::sounds[SoundEffects::COUNT];
 
 void Game::updateFlagCount() {
-    int flagCount = 0;
-    for (int r = 0; r < rows; r++) {
-        for (int c = 0; c < cols; c++) {
-            flagCount += board[r][c].isFlagged();
-        }
-    }
-
-    flagCounter.setString(std::to_string(flagCount)
+    flagCounter.setString(std::to_string(flagCount())
                         + "/"
                         + std::to_string(mineCount)
                         + " flags");
@@ -388,19 +402,46 @@ void Game::updateFlagCount() {
 }
 
 void Game::OnUpdate(double dt) {
+    TRACE_SCOPE("Game::OnUpdate");
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            board[r][c].animState.update(dt);
+        }
+    }
+
+    animState.update(dt);
+}
+
+void Game::OnRender(double alpha) {
+    // One span for the board, a span per tile would fill the trace in seconds
+    TRACE_SCOPE("Game::OnRender");
     int x = mouseX;
     int y = mouseY;
 
+    int activeAnims = 0;
     for (int r = 0; r < rows; r++) {
         for (int c = 0; c < cols; c++) {
             auto &tile = board[r][c];
-            tile.render(tile.isMouseOver(x, y));
-            tile.animState.update(dt);
+            {
+                ProfileScope scope(Phase::BOARD);
+                tile.render(tile.isMouseOver(x, y));
+            }
+            if (tile.animState.isAnimActive()) {
+                ProfileScope scope(Phase::ANIMATIONS);
+                tile.animState.render(alpha);
+                activeAnims += 1;
+            }
         }
     }
 
-    animState.update(dt);
+    {
+        ProfileScope scope(Phase::ANIMATIONS);
+        animState.render(alpha);
+        activeAnims += animState.isAnimActive();
+    }
+    Profiler.countAnims(activeAnims);
 
+    ProfileScope scope(Phase::BUTTONS);
     for (auto btn : buttons) {
         if (!btn->hidden) {
             btn->render(btn->isMouseOver(x, y));
@@ -418,46 +459,47 @@ Game::~Game() {
 }
 
 Game::Game(SDL_Window *window)
-    : rows(Difficulty::SIZES[1].rows)
-    , cols(Difficulty::SIZES[1].cols)
-    , seed(time(0))
-    , rng(seed)
+    : Minefield(time(0))
+    , mouseX(-1)
+    , mouseY(-1)
+    , effects(seed)
     , mainFont("assets/fonts/Arbutus-Regular.ttf")
-    , state(GameState::READY)
     , window(window)
+    , simulation(seed)
     , flagCounter(mainFont.raw(), "0/? flags", 0xA00000)
     , restartBtn(mainFont.raw(), "Restart!", 0xFF1000)
     , playAgainBtn(mainFont.raw(), "Play again?", 0x00C000)
     , speakerBtn()
 {
+    rows = Difficulty::SIZES[1].rows;
+    cols = Difficulty::SIZES[1].cols;
     loadMedia();
 }
 
 void Game::OnStart() {
-    load();
-    int loadedState = state;
+    simulation.start();
 
-    ready();
-
-    if (!tileDatas.empty()) {
-        for (int r = 0; r < rows; ++r) for (int c = 0; c < cols; ++c) {
-            board[r][c].load(tileDatas[r*cols+c]);
-        }
-        updateFlagCount();
-    }
-    if (loadedState) {
-        state = loadedState;
+    Save::Data saved;
+    if (load(saved)) {
+        restoreGame(saved);
+    } else {
+        submit({ Simulation::Move::RESET, 0, 0, rows, cols, false, {} });
     }
+    // Start with the board in place
+    finishMoves();
+}
+
+void Game::restoreGame(const Save::Data& data) {
+    submit({ Simulation::Move::RESTORE, 0, 0, data.rows, data.cols, false, data });
 }
 
-// Called on both initial start and restart
+// Called on both initial start and restart, once the Minefield was reset
 void Game::ready() {
-    mineCount = rows * cols * PERCENT_MINES;
     animState.kill();
 
     printf("Seed: %0u\n", seed);
-
-    resizeBoard();
+    // From the game's seed, so a replay of the same game animates the same
+    effects.seed(seed);
 
     for (int row = 0; row < MAX_FIELD_SIZE; ++row) {
         for (int col = 0; col < MAX_FIELD_SIZE; ++col) {
@@ -473,148 +515,132 @@ void Game::ready() {
 
     updateFlagCount();
 
-    state = GameState::READY;
+    TRACE_INSTANT("state", state);
 }
 
-void Game::save() {
-    if (!openSaveWriter()) {
-        puts("unable to write to save file");
-        return;
+void Game::submit(Simulation::Move move) {
+    simulation.submit(std::move(move));
+    if (Clock.isVirtual() || !simulation.isThreaded()) {
+        finishMoves();
     }
+}
 
-    for (size_t i = 0; i < sizeof(Save::HEADER)-1; ++i) {
-        writeByte(Save::HEADER[i]);
-    }
+void Game::finishMoves() {
+    simulation.wait();
+    applyMoves();
+}
 
-    writeByte('r');
-    writeByte((Uint8)rows);
-    writeByte('c');
-    writeByte((Uint8)cols);
+void Game::applyMoves() {
+    std::unique_ptr<const Simulation::Result> result;
+    while (simulation.poll(result)) {
+        apply(*result);
+    }
+}
 
-    writeByte('g');
-    writeByte((Uint8)state);
+void Game::apply(const Simulation::Result& result) {
+    // Results come in order, so the board is as the Simulation's was before the move
+    if (result.board) Minefield::restore(*result.board);
+    else if (result.changed && result.type == Simulation::Move::CLICK) uncover(result.flipped);
+    else if (result.changed && result.type == Simulation::Move::FLAG) toggleFlag(result.row, result.col);
+    Tile& tile = board[result.row][result.col];
 
-    for (int r = 0; r < rows; r++) {
-        for (int c = 0; c < cols; c++) {
-            writeByte('t');
-            writeByte(board[r][c].save());
+    switch (result.type) {
+    case Simulation::Move::CLICK:
+        if (!result.changed) break;
+        if (state != result.prevState) TRACE_INSTANT("state", state);
+        for (auto& flip : result.flipped) {
+            board[flip.row][flip.col].playRevealAnim(flip.delay);
         }
-    }
-    writeByte('z');
-    uint8_t bytes[sizeof(seed)];
-    memcpy(bytes, &seed, sizeof(seed));
-    for (size_t i = 0; i < sizeof(seed); i++) writeByte(bytes[i]);
+        if (!(result.prevState & GameState::STARTED)) {
+            // Fewer mines might have fit than planned
+            updateFlagCount();
+        }
+        onRevealTile(tile);
+        break;
 
-    writeByte('\0');
-    closeSaveFile();
-}
+    case Simulation::Move::FLAG:
+        if (!result.changed) break;
+        tile.playFlagAnim();
+        updateFlagCount();
+        playSoundEffect(tile.isFlagged() ? SoundEffects::FLAG : SoundEffects::WHOOSH);
+        break;
 
-void Game::load() {
-    if (!openSaveReader()) {
-        printf("no save file found\n");
-        return;
-    }
-    for (const char *c = Save::HEADER; *c != '\0'; ++c) {
-        Uint8 u8 = readByte();
-        if (u8 != *c) {
-            printf("Invalid or corrupted save file! Missing header.\n");
-        }
+    case Simulation::Move::RESET:
+    case Simulation::Move::RESTORE:
+        ready();
+        break;
     }
-    Uint8 data;
-    if ((data = readByte()) != 'r') {
-        printf("Missing rows data :: expected r (%d) got (%d)\n", 'r', data);
-        return;
-    }
-    rows = readByte();
+}
 
-    if (readByte() != 'c') {
-        printf("Missing cols data\n");
+void Game::save() {
+    TRACE_SCOPE("Game::save");
+    if (!openSaveWriter()) {
+        puts("unable to write to save file");
         return;
     }
-    cols = readByte();
-    resizeBoard();
 
-    if (readByte() != 'g') {
-        printf("Missing game state\n");
-        return;
-    }
-    state = readByte();
+    // The Simulation's board, it may be ahead of the one shown
+    std::vector<Uint8> bytes = Save::encode(simulation.snapshot());
+    writeBytes(bytes.data(), bytes.size());
+    closeSaveFile();
+}
 
-    tileDatas.resize(rows*cols, TileSaveData::DEFAULT);
-    for (int i = 0; (data = readByte()) == 't'; i++) {
-        tileDatas[i] = readByte();
+bool Game::load(Save::Data& data) {
+    TRACE_SCOPE("Game::load");
+    if (!openSaveReader()) {
+        printf("no save file found\n");
+        return false;
     }
-
-    if (data != 'z') {
-        printf("Missing seed\n");
-        return;
+    std::vector<Uint8> bytes;
+    Uint8 chunk[4096];
+    size_t count;
+    while ((count = readBytes(chunk, sizeof(chunk))) > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + count);
     }
-    uint8_t bytes[sizeof(seed)];
-    for (size_t i = 0; i < sizeof(seed); i++) bytes[i] = readByte();
-    memcpy(&seed, bytes, sizeof(seed));
-    rng.seed(seed);
-
     closeSaveFile();
-}
 
-void Game::resizeBoard() {
-    // Resize 2d vector
-    assert(rows < MAX_FIELD_SIZE);
-    assert(cols < MAX_FIELD_SIZE);
+    if (const char *error = Save::decode(bytes.data(), bytes.size(), data)) {
+        printf("Invalid or corrupted save file! (%s)\n", error);
+        return false;
+    }
+    return true;
 }
 
-void Game::restartGame() {
+void Game::restartGame(int rows, int cols) {
     playAgainBtn.hidden = true;
     restartBtn.hidden = false;
-    seed = rng();
-    ready();
+    submit({ Simulation::Move::RESET, 0, 0, rows, cols, true, {} });
 }
 
 static Tile* getTileUnderMouse(Game& self, int mouseX, int mouseY) {
-    for (int r = 0; r < self.rows; ++r) {
-        for (int c = 0; c < self.cols; ++c) {
-            if (self.board[r][c].isMouseOver(mouseX, mouseY)) {
-                return &self.board[r][c];
-            }
-        }
+    const Tile& origin = self.board[0][0];
+    int r, c;
+    if (self.cellAt(mouseX, mouseY, origin.x, origin.y, Tile::SIZE, r, c)) {
+        return &self.board[r][c];
     }
     return nullptr;
 }
 
 void Game::onClick(int x, int y) {
+    TRACE_INSTANT("click", (x << 16) | y);
     Tile *currentHover = getTileUnderMouse(*this, x, y);
-    if (currentHover && currentHover->isClickable()) {
-        if (state & GameState::STARTED) {
-            currentHover->flip();
-            onRevealTile(*currentHover);
-        } else {
-            // Build starting area
-            generateStartingArea(*currentHover);
-            state |= GameState::STARTED;
-        }
-    } else {
-        for (auto btn : buttons) {
-            if (btn->onclick && btn->isMouseOver(x, y)) {
-                btn->onclick();
-                return;
-            }
+    if (currentHover) {
+        submit({ Simulation::Move::CLICK, currentHover->row, currentHover->col, 0, 0, false, {} });
+        return;
+    }
+    for (auto btn : buttons) {
+        if (btn->onclick && !btn->hidden && btn->isMouseOver(x, y)) {
+            btn->onclick();
+            return;
         }
     }
 }
 
 void Game::onAltClick(int x, int y) {
-    if (state & GameState::OVER) return;
-
+    TRACE_INSTANT("altClick", (x << 16) | y);
     Tile *currentHover = getTileUnderMouse(*this, x, y);
-
-    if (currentHover && currentHover->isHidden()) {
-        // Flag tile
-        if (currentHover->isUnflagged()) {
-            currentHover->flag();
-        } else {
-            currentHover->unflag();
-        }
-        playSoundEffect(currentHover->isFlagged() ? SoundEffects::FLAG : SoundEffects::WHOOSH);
+    if (currentHover) {
+        submit({ Simulation::Move::FLAG, currentHover->row, currentHover->col, 0, 0, false, {} });
     }
 }
 
@@ -622,69 +648,24 @@ enum GameAnims {
     EXPLODE = 1,
 };
 
+// The Minefield already changed the cells, these only animate it
 void Game::onLost(Tile& mine) {
-    state |= GameState::LOST;
-
     mine.animState.kill();
-    mine.red();
 
     auto detonationAnim = new DetonationAnim {
         tileBackgrounds[TileBG::HIDDEN],
-        rng, {mine.x, mine.y},
+        effects, {mine.x, mine.y},
         SDL_Rect{board[0][0].x, board[0][0].y, cols * Tile::SIZE, rows * Tile::SIZE },
     };
     animState.play(GameAnims::EXPLODE, detonationAnim);
-
-    std::vector<Tile *> mines;
-    double delay = 0;
-    for (int r = 0; r < rows; r++) {
-        for (int c = 0; c < cols; c++) {
-            auto &tile = board[r][c];
-            if (tile.isMine() && tile.isUnflagged()) {
-                mines.push_back(&tile);
-            }
-        }
-    }
-    std::sort(mines.begin(), mines.end(), [&mine](const Tile *a, const Tile *b) {
-            const int aX = a->x - mine.x;
-            const int aY = a->y - mine.y;
-
-            const int bX = b->x - mine.x;
-            const int bY = b->y - mine.y;
-
-            const int aDistSq = aX*aX + aY*aY;
-            const int bDistSq = bX*bX + bY*bY;
-
-            return aDistSq < bDistSq;
-    });
-
-    const Uint32 deltaDelay = MINE_REVEAL_MILLISECONDS / mines.size();
-
-    // Skip first item, the detonated mine
-    for (auto it = mines.begin() + 1; it != mines.end(); ++it) {
-        (*it)->flip(false, delay);
-        delay += deltaDelay;
-    }
-
-    for (int y = 0; y < MAX_FIELD_SIZE; y++) {
-        for (int x = 0; x < MAX_FIELD_SIZE; x++) {
-            auto &tile = board[y][x];
-            if (tile.isSafe() && tile.isFlagged()) {
-                // Incorrect flag
-                tile.red();
-            }
-        }
-    }
 }
 
 void Game::onWon() {
-    state |= GameState::WON;
-    
     for (int r = 0; r < rows; r++) {
         for (int c = 0; c < cols; c++) {
             auto &tile = board[r][c];
             if (tile.isMine()) {
-                tile.dissapear();
+                tile.playWinAnim();
             }
         }
     }
@@ -695,7 +676,7 @@ void Game::onRevealTile(Tile& revealed) {
         onLost(revealed);
         playSoundEffect(SoundEffects::EXPLODE);
     }
-    else if (hasWon()) {
+    else if (state & GameState::WON) {
         onWon();
     }
     else {
@@ -716,110 +697,6 @@ void Game::onMouseMove(SDL_MouseMotionEvent const& e) {
     mouseY = e.y;
 }
 
-static void pushHiddenNeighbors(Tile& tile, std::vector<Tile*>& tiles, bool diagonals) {
-    tile.foreach_touching_tile([&tiles](Tile& neighbor) {
-        for (auto tile : tiles) if (tile == &neighbor) return;
-        if (neighbor.isHidden()) {
-            tiles.push_back(&neighbor);
-        }
-    }, diagonals);
-}
-
-void Game::flipTiles(Tile& root, int count, std::vector<Tile*>& revealqueue) {
-    std::vector<Tile*> tiles;
-    std::vector<Tile*> tospread;
-
-    // Start by adding all neighbors, including diagonals
-    pushHiddenNeighbors(root, tiles, true);
-
-    while (count > 0 && !tiles.empty()) {
-        // Select up to N random neighbors
-        std::shuffle(tiles.begin(), tiles.end(), rng);
-        int num = std::min(int(std::min((long unsigned)tiles.size(), 8UL)), count);
-
-        for (int i = 0; i < num; ++i) {
-            count -= 1;
-            // Force set hidden to not start reveal animation
-            tiles[i]->setHidden(false);
-
-            // Add to queue for delayed reveal animtion
-            revealqueue.push_back(tiles[i]);
-
-            // Add for hidden neighbors to be in next potential layer
-            tospread.push_back(tiles[i]);
-        }
-
-        tiles.clear();
-
-        // Build next layer
-        for (auto tile : tospread) {
-            pushHiddenNeighbors(*tile, tiles, false);
-        }
-        tospread.clear();
-    }
-}
-
-void Game::generateStartingArea(Tile& root) {
-    std::vector<Tile*> toreveal;
-
-    toreveal.push_back(&root);
-
-    root.setHidden(false);
-    root.setMine(false);
-
-    int count = STARTING_SAFE_COUNT;
-    flipTiles(root, count, toreveal);
-
-    generateMines();
-    Uint32 delay = 0;
-    for (auto& tile : toreveal) {
-        tile->flip(true, delay);
-        delay += FLIP_DELAY;
-    }
-
-    onRevealTile(root);
-}
-
-void Game::generateMines() {
-    std::uniform_int_distribution<> randrow(0, rows);
-    std::uniform_int_distribution<> randcol(0, cols);
-    for (int i = 0; i < mineCount; ++i) {
-        int rowPicked = randrow(rng);
-        int colPicked = randcol(rng);
-
-        // Find first available tile
-        Tile* tile = nullptr;
-        for (int _r = 0; _r < rows; ++_r)
-        for (int _c = 0; _c < cols; ++_c) {
-            // We want to start from the selected position and work our way around
-            // as if it's a circular array
-            int r = (_r + rowPicked) % rows;
-            int c = (_c + colPicked) % cols;
-
-            if (board[r][c].isHidden() && board[r][c].isSafe()) {
-                tile = &board[r][c];
-
-                // Escape from nested loop
-                goto found;
-            }
-        }
-
-        // NO FREE TILES:
-        {
-            mineCount = i;
-            break;
-        }
-
-
-    found:
-        // Found a free tile
-        tile->setMine(true);
-
-    }
-
-    updateFlagCount();
-}
-
 constexpr int TILE_BASE_SIZE = 32;
 constexpr float NUMBER_SCALE = 0.8;
 
@@ -841,18 +718,43 @@ static std::string TILE_FILES[TileBG::COUNT] = {
     "assets/images/square_red.png",
 };
 
-void Game::loadMedia() {
-    // TODO: immediate-mode style UI
+// Sounds and icons aren't needed for the first frame, the web build
+// downloads them after it instead of preloading them with the page
+#ifdef __EMSCRIPTEN__
+constexpr bool STREAM_MEDIA = true;
+#else
+constexpr bool STREAM_MEDIA = false;
+#endif
 
-    for (int i = 0; i < Icons::COUNT; ++i) {
-        icons[i].loadFile(ICON_FILES[i]);
+// Waits for every asset that was requested, so none is still decoding
+// when the caller gives up on a failed one. Returns false if any failed
+template <typename T, size_t N>
+static bool collect(std::future<T*> (&assets)[N], T *(&results)[N]) {
+    bool ok = true;
+    for (size_t i = 0; i < N; ++i) {
+        const bool requested = assets[i].valid();
+        results[i] = requested ? assets[i].get() : nullptr;
+        if (requested && results[i] == nullptr) ok = false;
     }
+    return ok;
+}
 
-    icons[Icons::SOUND].setMultColor(UI_COLOR_MOD, UI_COLOR_MOD, UI_COLOR_MOD);
-    icons[Icons::MUTED].setMultColor(UI_COLOR_MOD, UI_COLOR_MOD, UI_COLOR_MOD);
+void Game::loadMedia() {
+    // TODO: immediate-mode style UI
 
-    for (int i = 0; i < TileBG::COUNT; ++i) {
-        tileBackgrounds[i].loadFile(TILE_FILES[i]);
+    // Images and sounds are decoded on worker threads while the text is
+    // rendered here, only the textures are created on this thread
+    std::future<SDL_Surface*> iconImages[Icons::COUNT];
+    std::future<SDL_Surface*> tileImages[TileBG::COUNT];
+    std::future<SDL_Surface*> overlayImages[TileOverlay::COUNT];
+    std::future<Mix_Chunk*> soundChunks[SoundEffects::COUNT];
+    for (int i = 0; i < TileBG::COUNT; ++i) tileImages[i] = Assets::decodeImage(TILE_FILES[i]);
+    for (int i = 0; i < TileOverlay::COUNT; ++i) overlayImages[i] = Assets::decodeImage(OVERLAY_FILES[i]);
+    if (!STREAM_MEDIA) {
+        for (int i = 0; i < Icons::COUNT; ++i) iconImages[i] = Assets::decodeImage(ICON_FILES[i]);
+        if (Audio::isOpen()) {
+            for (int i = 0; i < SoundEffects::COUNT; ++i) soundChunks[i] = Assets::decodeSound(SOUND_FILES[i]);
+        }
     }
 
     for (int i = 0; i < NUMBER_TILES_COUNT; ++i) {
@@ -862,8 +764,27 @@ void Game::loadMedia() {
         tileNumbers[i].loadText(mainFont.raw(), num, color.as_sdl());
     }
 
+    SDL_Surface *iconSurfaces[Icons::COUNT];
+    SDL_Surface *tileSurfaces[TileBG::COUNT];
+    SDL_Surface *overlaySurfaces[TileOverlay::COUNT];
+    Mix_Chunk *chunks[SoundEffects::COUNT];
+    bool ok = collect(iconImages, iconSurfaces);
+    ok = collect(tileImages, tileSurfaces) && ok;
+    ok = collect(overlayImages, overlaySurfaces) && ok;
+    ok = collect(soundChunks, chunks) && ok;
+    // The failures were already reported
+    if (!ok) exit(1);
+
+    for (int i = 0; i < Icons::COUNT && !STREAM_MEDIA; ++i) {
+        loadIcon(i, iconSurfaces[i]);
+    }
+
+    for (int i = 0; i < TileBG::COUNT; ++i) {
+        tileBackgrounds[i].loadSurface(tileSurfaces[i]);
+    }
+
     for (int i = 0; i < TileOverlay::COUNT; ++i) {
-        tileOverlays[i].loadFile(OVERLAY_FILES[i]);
+        tileOverlays[i].loadSurface(overlaySurfaces[i]);
     }
     tileOverlays[TileOverlay::MINE].setMultColor(0.0, 0.0, 0.0);
 
@@ -874,11 +795,13 @@ void Game::loadMedia() {
     playAgainBtn.load();
     playAgainBtn.hidden = true;
 
-    restartBtn.onclick = [this](){ restartGame(); };
-    playAgainBtn.onclick = [this](){ restartGame(); };
+    restartBtn.onclick = [this](){ restartGame(rows, cols); };
+    playAgainBtn.onclick = [this](){ restartGame(rows, cols); };
 
 
     speakerBtn.background = &icons[Icons::SOUND];
+    // Shown once both icons are there
+    speakerBtn.hidden = !icons[Icons::SOUND].loaded() || !icons[Icons::MUTED].loaded();
     speakerBtn.onclick = [this](){
         muted = !muted;
         speakerBtn.background = &icons[muted ? Icons::MUTED : Icons::SOUND];
@@ -894,7 +817,7 @@ void Game::loadMedia() {
     {
 
         const int NUMBTNS = sizeof(Difficulty::SIZES) / sizeof(Difficulty::SIZES[0]);
-        difficultyBtns.resize(NUMBTNS, mainFont.raw());
+        while (difficultyBtns.size() < NUMBTNS) difficultyBtns.emplace_back(mainFont.raw());
 
         for (int i = 0; i < NUMBTNS; ++i) {
             auto& btn = difficultyBtns[i];
@@ -905,20 +828,14 @@ void Game::loadMedia() {
 
     for (size_t i = 0; i < difficultyBtns.size(); ++i) {
         difficultyBtns[i].onclick = [this, i]() {
-            rows = Difficulty::SIZES[i].rows;
-            cols = Difficulty::SIZES[i].cols;
-            resizeBoard();
-            restartGame();
+            restartGame(Difficulty::SIZES[i].rows, Difficulty::SIZES[i].cols);
         };
     }
 
-    for (int i = 0; i < SoundEffects::COUNT; ++i) {
-        sounds[i] = Mix_LoadWAV((Sim.runtimeBasePath + SOUND_FILES[i]).c_str());
-        if (sounds[i] == nullptr) {
-            fprintf(stderr, "Failed to load sound: %s\n", Mix_GetError());
-            exit(1);
-        }
+    for (int i = 0; i < SoundEffects::COUNT && Audio::isOpen() && !STREAM_MEDIA; ++i) {
+        sounds[i] = chunks[i];
     }
+    Audio::reserveChannels(SoundEffects::COUNT, SOUND_VOLUMES);
 
     buttons.push_back(&restartBtn);
     buttons.push_back(&playAgainBtn);
@@ -927,6 +844,36 @@ void Game::loadMedia() {
 
 }
 
+void Game::loadIcon(int icon, SDL_Surface *surface) {
+    icons[icon].loadSurface(surface);
+    icons[icon].setMultColor(UI_COLOR_MOD, UI_COLOR_MOD, UI_COLOR_MOD);
+}
+
+void Game::streamMedia() {
+    if (!STREAM_MEDIA) return;
+
+    for (int i = 0; i < Icons::COUNT; ++i) {
+        Assets::fetch(ICON_FILES[i], [this, i](bool ok) {
+            SDL_Surface *surface = ok ? Assets::decodeImage(ICON_FILES[i]).get() : nullptr;
+            if (surface == nullptr) return;
+            loadIcon(i, surface);
+            if (icons[Icons::SOUND].loaded() && icons[Icons::MUTED].loaded()) {
+                speakerBtn.hidden = false;
+                positionItems();
+            }
+        });
+    }
+
+    for (int i = 0; i < SoundEffects::COUNT && Audio::isOpen(); ++i) {
+        Assets::fetch(SOUND_FILES[i], [i](bool ok) {
+            Mix_Chunk *chunk = ok ? Assets::decodeSound(SOUND_FILES[i]).get() : nullptr;
+            if (chunk == nullptr) return;
+            if (muted) Mix_VolumeChunk(chunk, 0);
+            sounds[i] = chunk;
+        });
+    }
+}
+
 void Game::positionItems() {
     int y = 0;
 
@@ -990,26 +937,17 @@ void Game::positionItems() {
     playAgainBtn.setX(x);
     playAgainBtn.setY(y);
 
-    speakerBtn.setScale((double)playAgainBtn.getHeight() / (double)speakerBtn.background->getHeight());
-    x -= speakerBtn.getWidth() + 10;
-    speakerBtn.x = x;
-    speakerBtn.y = y;
+    if (!speakerBtn.hidden) {
+        speakerBtn.setScale((double)playAgainBtn.getHeight() / (double)speakerBtn.background->getHeight());
+        x -= speakerBtn.getWidth() + 10;
+        speakerBtn.x = x;
+        speakerBtn.y = y;
+    }
 
     if (false && y > SCREEN_HEIGHT) {
         SDL_SetWindowSize(window, SCREEN_WIDTH, y);
     }
 }
 
-bool Game::hasWon() {
-    for (int r = 0; r < rows; r++) {
-        for (int c = 0; c < cols; c++) {
-            if (board[r][c].isHidden() && board[r][c].isSafe()) {
-                return false;
-            }
-        }
-    }
-    // All tiles that aren't mines have been revealed!
-    return true;
-}
 
 
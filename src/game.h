@@ -4,6 +4,8 @@
 #include "button.h"
 #include "anim.h"
 #include "tile.h"
+#include "save.h"
+#include "simulation.h"
 
 #include <ctime>
 #include <vector>
@@ -13,14 +15,6 @@
 #include <memory>
 #include <deque>
 
-enum GameState {
-    READY = 0,
-    STARTED = 1,
-    WON = 2,
-    LOST = 4,
-    OVER = WON | LOST,
-};
-
 namespace SoundEffects {
     enum {
         FLAG    = 0,
@@ -39,57 +33,69 @@ namespace Icons {
     };
 }
 
-
-#define MAX_FIELD_SIZE 50
-
-class Game {
+// Plays a Minefield: draws it, animates it and turns input into moves.
+// The moves are made by the Simulation on its own thread, the Game's own
+// Minefield is a copy of the board as of the last result it took over.
+class Game : public Minefield {
 public:
     Game(SDL_Window *window);
     ~Game();
 
+    // Join the simulation thread, no moves are taken after this
+    void shutdown() { simulation.stop(); }
+
     // Renderer and window are global
 
     void loadMedia();
+    // Start downloading what loadMedia left out, call after the first frame
+    void streamMedia();
     bool initialRender();
 
+    // Advance animations by one simulation step
     void OnUpdate(double dt);
+    void OnRender(double alpha);
     void OnStart();
     void save();
-    void load();
+    // Returns false if there's no valid save to restore
+    bool load(Save::Data& data);
+    // Replace the current game with a saved one
+    void restoreGame(const Save::Data& data);
+
+    // Take over and animate the moves the Simulation finished, call once per frame.
+    // Never waits for the ones still running
+    void applyMoves();
+    // Moves handed to the Simulation and moves applied so far
+    [[nodiscard]] long movesSubmitted() const { return simulation.submittedCount(); }
+    [[nodiscard]] long movesApplied() const { return simulation.polledCount(); }
 
     void onClick(int x, int y);
     void onAltClick(int x, int y);
 
     void onMouseMove(SDL_MouseMotionEvent const& e);
 
-    int rows, cols;
-
     int mouseX, mouseY;
 
     // std::array? why should I care?
     Tile board[MAX_FIELD_SIZE][MAX_FIELD_SIZE];
 
-    uint32_t seed;
-    std::mt19937 rng;
-
     AnimState animState;
+    // Only for effects, so animations don't change the game's rng
+    std::mt19937 effects;
     void updateFlagCount();
     void positionItems();
 
-    int mineCount;
-
     char* saveDirectory;
 
     static Mix_Chunk* sounds[SoundEffects::COUNT];
 
     Font mainFont;
-    int state;
 
     Texture tileBackgrounds[TileBG::COUNT];
     Texture tileOverlays[TileOverlay::COUNT];
     Texture tileNumbers[NUMBER_TILES_COUNT];
 private:
     SDL_Window *window;
+    Simulation simulation;
 
     Text flagCounter;
     TextButton restartBtn;
@@ -102,24 +108,24 @@ private:
     Texture icons[Icons::COUNT];
 
     TextButton& activeRestartButton();
+    void loadIcon(int icon, SDL_Surface *surface);
 
     void ready();
-    void resizeBoard();
-    void restartGame();
+    void restartGame(int rows, int cols);
+
+    // Hand a move to the Simulation. On virtual time, and without threads,
+    // it's waited for so moves take effect in the same frame
+    void submit(Simulation::Move move);
+    // Wait for every submitted move and apply it
+    void finishMoves();
+    void apply(const Simulation::Result& result);
     void onLost(Tile& mine);
     void onWon();
-    bool hasWon();
-    void generateStartingArea(Tile& tile);
-    void generateMines();
-    void flipTiles(Tile& root, int count, std::vector<Tile*>& toreveal);
 
     void onRevealTile(Tile& tile);
-
-    std::vector<Uint8> tileDatas;
 };
 
 namespace Save {
-    extern const char HEADER[];
     extern const char *FILE;
 }
 
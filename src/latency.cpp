@@ -0,0 +1,96 @@
+#include "latency.h"
+#include "trace.h"
+#include <SDL_timer.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+struct Pending {
+    // Milliseconds the event waited in SDL's queue before it was polled
+    Uint32 queued;
+    Uint64 polled;
+    // Moves the game had been given once this event was handled, -1 until then
+    long moves;
+};
+
+static std::vector<Pending> pending;
+// The last HISTORY samples in milliseconds, sample i at i % HISTORY
+static double samples[Latency::HISTORY];
+static size_t count;
+// Over every sample, for report()
+static double total;
+static double slowest;
+
+// Touch taps act on release, see mainloop()
+static bool isInput(const SDL_Event& e) {
+    switch (e.type) {
+    case SDL_MOUSEBUTTONDOWN:
+        return e.button.which != SDL_TOUCH_MOUSEID;
+    case SDL_MOUSEBUTTONUP:
+        return e.button.which == SDL_TOUCH_MOUSEID;
+    case SDL_KEYDOWN:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Latency::noteEvent(const SDL_Event& e) {
+    if (!isInput(e)) return;
+    // Event timestamps are SDL_GetTicks, only the time since the poll is measured precisely
+    const Uint32 now = SDL_GetTicks();
+    const Uint32 queued = now >= e.common.timestamp ? now - e.common.timestamp : 0;
+    pending.push_back({ queued, SDL_GetPerformanceCounter(), -1 });
+}
+
+void Latency::submitted(long moves) {
+    for (auto& event : pending) {
+        if (event.moves < 0) event.moves = moves;
+    }
+}
+
+void Latency::applied(long moves) {
+    if (pending.empty()) return;
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const double freq = SDL_GetPerformanceFrequency();
+    // Events whose moves are still running wait for a later frame
+    auto shown = std::stable_partition(pending.begin(), pending.end(), [moves](const Pending& event) {
+        return event.moves < 0 || event.moves > moves;
+    });
+    for (auto event = shown; event != pending.end(); ++event) {
+        const double ms = event->queued + (now - event->polled) * 1000.0 / freq;
+        samples[count++ % Latency::HISTORY] = ms;
+        total += ms;
+        slowest = std::max(slowest, ms);
+        TRACE_INSTANT("inputLatencyUs", Sint64(ms * 1000.0));
+    }
+    pending.erase(shown, pending.end());
+}
+
+static double percentile(double *values, size_t size, double p) {
+    double *nth = values + size_t(p * (size - 1));
+    std::nth_element(values, nth, values + size);
+    return *nth;
+}
+
+bool Latency::stats(double& p50, double& p99, double& max) {
+    if (count == 0) return false;
+    const size_t size = std::min(count, size_t(HISTORY));
+    double recent[HISTORY];
+    std::copy(samples, samples + size, recent);
+    p50 = percentile(recent, size, 0.5);
+    p99 = percentile(recent, size, 0.99);
+    max = *std::max_element(recent, recent + size);
+    return true;
+}
+
+void Latency::report() {
+    if (count == 0) return;
+    const size_t size = std::min(count, size_t(HISTORY));
+    double recent[HISTORY];
+    std::copy(samples, samples + size, recent);
+    printf("Input to present latency over %zu events: mean %.1f ms  max %.1f ms, "
+           "last %zu: p50 %.1f ms  p90 %.1f ms  p99 %.1f ms\n",
+           count, total / count, slowest, size,
+           percentile(recent, size, 0.5), percentile(recent, size, 0.9), percentile(recent, size, 0.99));
+}
@@ -0,0 +1,34 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <SDL_events.h>
+
+// Measures the time from an input event until the game applied its result.
+// Clicks and key presses are timestamped as they are polled and resolved
+// once the moves they caused came back from the Simulation. Only events
+// that act are counted: key presses, mouse button presses, and for touch the release
+// that taps. Mouse motion would drown out the clicks.
+namespace Latency {
+    // Samples kept for the percentiles
+    constexpr int HISTORY = 256;
+
+    // Call for every polled event, ignores anything that isn't input
+    void noteEvent(const SDL_Event& e);
+
+    // Call once the frame's input was handed to the game, with the number
+    // of moves it was given so far
+    void submitted(long moves);
+
+    // Call once the game took over finished moves, with the number it applied so far
+    void applied(long moves);
+
+    // Milliseconds from event to applied result over the last HISTORY samples.
+    // Returns false before the first sample
+    bool stats(double& p50, double& p99, double& max);
+
+    // Print the count, mean and max of every sample and the percentiles
+    // of the last HISTORY, if there were any
+    void report();
+}
+
+#endif
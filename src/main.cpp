@@ -6,29 +6,41 @@
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <SDL_mixer.h>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
 
 #ifdef __EMSCRIPTEN__
     #include <emscripten.h>
 #endif
 
 #include "texture.h"
+#include "clock.h"
+#include "audio.h"
+#include "profiler.h"
+#include "trace.h"
+#include "latency.h"
 #include "game.h"
 #include "backend.h"
 #include "frontend.h"
+#include "queue.h"
 
 constexpr int SCREEN_WIDTH  = 640 * 1.2;
 constexpr int SCREEN_HEIGHT = 480 * 1.2;
+// Longest virtual frame MINEVIRTUALTIME accepts, in milliseconds
+constexpr unsigned MAX_VIRTUAL_STEP = 1000;
 
 #define TOUCH_HOLD_TICKS 200
 
 SDL_Renderer *renderer;
 static Game *game;
 
-static bool running = true;
+static std::atomic<bool> running { true };
 
-App::App() : isFullscreen{}, window{} {}
+App::App() : isFullscreen{}, window{}, headless{}, canvas{}, noRender{}, lowLatency{}, refreshRate{} {}
 
 App::~App() {
     // Crashes on Wayland
@@ -39,6 +51,9 @@ App::~App() {
     if (window) SDL_DestroyWindow(window);
     window = nullptr;
 
+    if (canvas) SDL_FreeSurface(canvas);
+    canvas = nullptr;
+
     IMG_Quit();
     TTF_Quit();
     Mix_Quit();
@@ -56,27 +71,81 @@ void App::init() {
     }
     printf("Runtime path: %s\n", runtimeBasePath.c_str()); fflush(stdout);
 
+    // Milliseconds of game time per frame, independent of the wall clock
+    const char *env_virtualtime = std::getenv("MINEVIRTUALTIME");
+    if (env_virtualtime) {
+        // strtoul takes "-1" as a huge number, so digits only
+        char *end;
+        const unsigned long step = std::strtoul(env_virtualtime, &end, 10);
+        if (!isdigit((unsigned char)*env_virtualtime) || *end || step == 0 || step > MAX_VIRTUAL_STEP) {
+            fprintf(stderr, "MINEVIRTUALTIME must be milliseconds per frame from 1 to %u, not \"%s\"\n",
+                    MAX_VIRTUAL_STEP, env_virtualtime);
+            exit(1);
+        }
+        Clock.setVirtual(Uint32(step));
+    }
+
+    // Overrides the frontend's default, MINEHEADLESS=0 forces a window
+    const char *env_headless = std::getenv("MINEHEADLESS");
+    if (env_headless && *env_headless) {
+        headless = strcmp(env_headless, "0") != 0;
+    }
+
+    const char *env_lowlatency = std::getenv("MINELOWLATENCY");
+    if (env_lowlatency && *env_lowlatency) {
+        lowLatency = strcmp(env_lowlatency, "0") != 0;
+    }
+
+    if (headless) {
+        // No display needed, audio isn't opened at all
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0) {
         fprintf(stderr, "SDL could not initialize! SDL Error: %s\n", SDL_GetError());
         exit(1);
     }
 
-    window = SDL_CreateWindow("MineSector", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
-    if (window == nullptr) {
-        fprintf(stderr, "Unable to create window. SDL Error: %s\n", SDL_GetError());
-        exit(1);
+    if (headless) {
+        canvas = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+        if (canvas == nullptr) {
+            fprintf(stderr, "Unable to create canvas. SDL Error: %s\n", SDL_GetError());
+            exit(1);
+        }
+
+        renderer = SDL_CreateSoftwareRenderer(canvas);
+        if (renderer == nullptr) {
+            fprintf(stderr, "Unable to create software renderer. SDL Error: %s\n", SDL_GetError());
+            exit(1);
+        }
     }
+    else {
+        window = SDL_CreateWindow("MineSector", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+        if (window == nullptr) {
+            fprintf(stderr, "Unable to create window. SDL Error: %s\n", SDL_GetError());
+            exit(1);
+        }
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    if (renderer == nullptr) {
-        fprintf(stderr, "Unable to create accelerated renderer. SDL Error: %s\n", SDL_GetError());
-        exit(1);
+        // Waiting on vsync in present can hold a frame that already shows the input
+        const Uint32 vsync = lowLatency ? 0 : SDL_RENDERER_PRESENTVSYNC;
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | vsync);
+        if (renderer == nullptr) {
+            // No GPU, e.g. a remote display
+            printf("Unable to create accelerated renderer, using software renderer. SDL Error: %s\n", SDL_GetError());
+            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+        }
+        if (renderer == nullptr) {
+            fprintf(stderr, "Unable to create renderer. SDL Error: %s\n", SDL_GetError());
+            exit(1);
+        }
     }
 
     SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
 
-
-
+    SDL_DisplayMode mode;
+    if (window && SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) == 0 && mode.refresh_rate > 0) {
+        refreshRate = mode.refresh_rate;
+    }
     int imgFlags = IMG_INIT_PNG;
     if (!(IMG_Init(imgFlags) & imgFlags)) {
         fprintf(stderr, "SDL_image could not initialize: %s\n", IMG_GetError());
@@ -88,9 +157,8 @@ void App::init() {
         exit(1);
     }
 
-    if (Mix_OpenAudio(/* Frequency */ 44100, MIX_DEFAULT_FORMAT, /* Channels */ 2, /* Chunksize */ 2048) < 0) {
-        fprintf(stderr, "SDL_mixer count not initialize: %s", Mix_GetError());
-        exit(1);
+    if (!headless) {
+        Audio::open(lowLatency);
     }
 
     SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
@@ -109,14 +177,17 @@ static int event_filter(void *userdata, SDL_Event *e) {
         Uint32 current = SDL_GetTicks();
 
         if (current - lastFrame >= TICKS_PER_FRAME) {
-            double dt = (current - lastFrame) / 1000.0;
             lastFrame = current;
+            Clock.tick();
 
             SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
             SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
             SDL_RenderClear(renderer);
                 
-            game->OnUpdate(dt);
+            while (Clock.step()) {
+                game->OnUpdate(SIM_STEP);
+            }
+            game->OnRender(Clock.alpha());
 
             SDL_RenderPresent(renderer);
         }
@@ -128,25 +199,88 @@ static int event_filter(void *userdata, SDL_Event *e) {
 
 Color bgColor = 0xE0E0E0;
 
+// Calls into the backend from any thread are queued here and run on the
+// main thread once per frame, after input is handled
+struct Command {
+    enum Type {
+        SAVE,
+        CLICK,
+        ALT_CLICK,
+        QUIT,
+    };
+
+    Type type;
+    int x, y;
+};
+
+// A frame's worth of commands for even the fastest bot
+static constexpr size_t COMMAND_CAPACITY = 1024;
+static MpscQueue<Command, COMMAND_CAPACITY> commands;
+static std::thread::id mainThread;
+
+static bool onMainThread() {
+    return std::this_thread::get_id() == mainThread;
+}
+
+static void runCommand(const Command& command) {
+    switch (command.type) {
+    case Command::SAVE:
+        game->save();
+        break;
+    case Command::CLICK:
+        game->onClick(command.x, command.y);
+        break;
+    case Command::ALT_CLICK:
+        game->onAltClick(command.x, command.y);
+        break;
+    case Command::QUIT:
+        running = false;
+        break;
+    }
+}
+
+// Commands after a quit are dropped
+static void runCommands() {
+    TRACE_SCOPE("runCommands");
+    Command command;
+    while (running && commands.pop(command)) {
+        runCommand(command);
+    }
+}
+
+static void submit(Command command) {
+    if (!running) return;
+    while (!commands.push(std::move(command))) {
+        // Nothing drains the queue after a quit, drop the command
+        if (!running) return;
+        // Full, make room if this is the thread that drains it
+        if (onMainThread()) runCommands();
+        else std::this_thread::yield();
+    }
+}
+
 extern "C" {
     void save(void) {
         if (!running) return;
-        game->save();
+        // The web saves when the page is hidden and frames stop, don't wait for one
+        if (onMainThread()) {
+            runCommands();
+            game->save();
+            return;
+        }
+        submit({ Command::SAVE, 0, 0 });
     }
 
     void onClick(int x, int y) {
-        if (!running) return;
-        game->onClick(x, y);
+        submit({ Command::CLICK, x, y });
     }
 
     void onAltClick(int x, int y) {
-        if (!running) return;
-        game->onAltClick(x, y);
+        submit({ Command::ALT_CLICK, x, y });
     }
 
     void quit(void) {
-        if (!running) return;
-        running = false;
+        submit({ Command::QUIT, 0, 0 });
     }
 }
 
@@ -154,12 +288,12 @@ extern "C" {
 static Uint32 touchFingerDown;
 #endif
 
-extern "C" bool screenshot(void) {
+extern "C" SDL_Surface *captureBoard(void) {
     // Clear and redraw screen
     SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     SDL_RenderClear(renderer);
-    game->OnUpdate(0.0);
+    game->OnRender(Clock.alpha());
 
     // Calculate positions
     SDL_Rect viewport;
@@ -174,30 +308,49 @@ extern "C" bool screenshot(void) {
 
     // Copy pixels to image
     SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, area.w, area.h, 32, SDL_PIXELFORMAT_RGBA32);
-    bool res = true;
     if (SDL_RenderReadPixels(renderer, &area, SDL_PIXELFORMAT_RGBA32, surface->pixels, surface->pitch) < 0) {
         printf("Failed to take screenshot (%s)\n", SDL_GetError());
         SDL_FreeSurface(surface);
-        return false;
+        return nullptr;
 
     }
+    return surface;
+}
+
+Save::Data snapshotGame(void) {
+    return game->snapshot();
+}
+
+void restoreGame(const Save::Data& data) {
+    game->restoreGame(data);
+}
+
+SDL_Point tileCenter(int row, int col) {
+    const Tile& tile = game->board[row][col];
+    return { tile.x + Tile::SIZE / 2, tile.y + Tile::SIZE / 2 };
+}
+
+extern "C" bool screenshot(void) {
+    SDL_Surface *surface = captureBoard();
+    if (surface == nullptr) return false;
+
     SDL_SaveBMP(surface, "out.bmp");
 
     SDL_FreeSurface(surface);
-    return res;
+    return true;
 }
 
 static void mainloop() {
-    Uint32 current = SDL_GetTicks();
-    double dt = (current - lastFrame) / 1000.0;
-    lastFrame = current;
-
-    bgColor.draw();
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-    SDL_RenderClear(renderer);
+    lastFrame = SDL_GetTicks();
+    Clock.tick();
+    Profiler.beginFrame();
+    TRACE_SCOPE("mainloop");
+    const double dt = Clock.delta();
 
+    ProfileScope eventsScope(Phase::EVENTS);
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
+        Latency::noteEvent(e);
         switch (e.type) {
         case SDL_QUIT:
 #ifdef __EMSCRIPTEN__
@@ -225,6 +378,9 @@ static void mainloop() {
             else if (e.key.keysym.sym == SDLK_t) {
                 printf("dt: %f\n", dt);
             }
+            else if (e.key.keysym.sym == SDLK_F3) {
+                Profiler.toggle();
+            }
             else if (e.key.keysym.sym == SDLK_F11) {
                 bool isFullscreen = SDL_GetWindowFlags(Sim.window) & SDL_WINDOW_FULLSCREEN;
                 if (isFullscreen) {
@@ -243,8 +399,9 @@ static void mainloop() {
 
 #ifdef FRONTEND_NATIVE
         case SDL_MOUSEBUTTONDOWN:
+            Audio::noteInput(e.button.timestamp);
             if (e.button.which == SDL_TOUCH_MOUSEID) {
-                touchFingerDown = current;
+                touchFingerDown = Clock.ticks();
             }
             else if (e.button.button == SDL_BUTTON_LEFT) {
                 onClick(e.button.x, e.button.y);
@@ -272,7 +429,7 @@ static void mainloop() {
     }
 
 #ifdef FRONTEND_NATIVE
-    if (touchFingerDown && current >= touchFingerDown + TOUCH_HOLD_TICKS) {
+    if (touchFingerDown && Clock.ticks() >= touchFingerDown + TOUCH_HOLD_TICKS) {
         // We've touched for TOUCH_HOLD_TICKS time, now simulate right click
         int x,y;
         SDL_GetMouseState(&x, &y);
@@ -281,21 +438,93 @@ static void mainloop() {
     }
 #endif
 
-    game->OnUpdate(dt);
+    frontend_update();
+    runCommands();
+    Latency::submitted(game->movesSubmitted());
+    // Moves finished since the last frame, sounds they play may be from this frame's input.
+    // Moves still running show up in a later frame
+    game->applyMoves();
+    Latency::applied(game->movesApplied());
+    // Later sounds weren't caused by this frame's input
+    Audio::noteInput(0);
+    eventsScope.stop();
+
+    // Simulate in fixed steps, then draw interpolated between the last two
+    {
+        ProfileScope scope(Phase::ANIMATIONS);
+        while (Clock.step()) {
+            game->OnUpdate(SIM_STEP);
+        }
+    }
+
+    if (Sim.noRender) return;
+
+    // Cleared only now so the frame is drawn after all of this frame's input
+    bgColor.draw();
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderClear(renderer);
+    game->OnRender(Clock.alpha());
+
+    if (Profiler.visible) {
+        Profiler.render(game->mainFont.raw());
+    }
 
+    ProfileScope scope(Phase::PRESENT);
     SDL_RenderPresent(renderer);
+
+    static bool firstFrame = true;
+    if (firstFrame) {
+        firstFrame = false;
+        printf("First frame after %u ms\n", SDL_GetTicks());
+        game->streamMedia();
+    }
 }
 
+#ifndef __EMSCRIPTEN__
+// Sleep until `deadline` on the high resolution counter, then move it to
+// the next frame. SDL_Delay can oversleep by a millisecond or more, so it
+// wakes up early and spins for the rest
+static void waitForDeadline(Uint64& deadline, int fps) {
+    constexpr double SPIN_MS = 2.0;
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 period = freq / fps;
+
+    deadline += period;
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now >= deadline) {
+        // Missed it, don't try to catch up with frames back-to-back
+        deadline = now;
+        return;
+    }
+
+    const double remaining = (deadline - now) * 1000.0 / freq;
+    if (remaining > SPIN_MS) {
+        SDL_Delay(Uint32(remaining - SPIN_MS));
+    }
+    while (SDL_GetPerformanceCounter() < deadline) {}
+}
+#endif
+
 App Sim;
 
 int main(int argc, char **argv) {
     (void)argc;
+    mainThread = std::this_thread::get_id();
+    // Frontend may configure Sim before it's initialized
+    frontend_init(&argv[1]);
+    Trace::init();
+
     Sim.init();
 
-    frontend_init(&argv[1]);
+    // Show the background while the assets load
+    bgColor.draw();
+    SDL_RenderClear(renderer);
+    SDL_RenderPresent(renderer);
+
     Game _game(Sim.window);
     game = &_game;
     lastFrame = SDL_GetTicks();
+    Clock.start();
     _game.OnStart();
 
     SDL_SetEventFilter(event_filter, &_game);
@@ -305,15 +534,34 @@ int main(int argc, char **argv) {
     emscripten_set_main_loop(mainloop, 0, 1);
     //emscripten_set_main_loop_arg(mainloop, &game, 0, 1);
 #else
+    const int fps = Sim.refreshRate ? Sim.refreshRate : FPS;
+    Uint64 deadline = SDL_GetPerformanceCounter();
+    if (Sim.lowLatency) {
+        printf("Low latency mode, pacing at %d Hz\n", fps);
+    }
+
     while (running) {
         mainloop();
 
-        const int updateTime = SDL_GetTicks() - lastFrame;
-        if (updateTime < TICKS_PER_FRAME) {
-            SDL_Delay(TICKS_PER_FRAME - updateTime);
+        // Virtual time doesn't wait on the wall clock
+        if (Clock.isVirtual()) continue;
+
+        if (Sim.lowLatency) {
+            waitForDeadline(deadline, fps);
+        }
+        else {
+            const int updateTime = SDL_GetTicks() - lastFrame;
+            if (updateTime < TICKS_PER_FRAME) {
+                SDL_Delay(TICKS_PER_FRAME - updateTime);
+            }
         }
     }
+    frontend_quit();
     game->save();
+    Latency::report();
+    // Every thread that records spans is joined by now
+    game->shutdown();
+    Trace::flush();
 #endif
 
 
@@ -0,0 +1,322 @@
+#include "minefield.h"
+#include <algorithm>
+#include <cassert>
+
+constexpr uint32_t MINE_REVEAL_MILLISECONDS = 5000;
+constexpr uint32_t FLIP_DELAY = 100;
+
+constexpr float PERCENT_MINES = 0.15;
+
+constexpr int STARTING_SAFE_COUNT = 15;
+
+Minefield::Minefield(uint32_t seed)
+    : rows(0)
+    , cols(0)
+    , seed(seed)
+    , rng(seed)
+    , mineCount(0)
+    , state(GameState::READY)
+    , flags(0)
+{
+    std::fill(&cells[0][0], &cells[0][0] + MAX_FIELD_SIZE*MAX_FIELD_SIZE, TileSaveData::DEFAULT);
+    std::fill(&numbers[0][0], &numbers[0][0] + MAX_FIELD_SIZE*MAX_FIELD_SIZE, 0);
+}
+
+void Minefield::set(int r, int c, uint8_t bit, bool on) {
+    if (on) cells[r][c] |= bit;
+    else cells[r][c] &= ~bit;
+}
+
+bool Minefield::isClickable(int r, int c) const {
+    return isHidden(r, c) && !isFlagged(r, c) && !(state & GameState::OVER);
+}
+
+bool Minefield::hasWon() const {
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            if (isHidden(r, c) && !isMine(r, c)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Minefield::reset() {
+    assert(rows < MAX_FIELD_SIZE);
+    assert(cols < MAX_FIELD_SIZE);
+
+    mineCount = rows * cols * PERCENT_MINES;
+    std::fill(&cells[0][0], &cells[0][0] + MAX_FIELD_SIZE*MAX_FIELD_SIZE, TileSaveData::DEFAULT);
+    std::fill(&numbers[0][0], &numbers[0][0] + MAX_FIELD_SIZE*MAX_FIELD_SIZE, 0);
+    flags = 0;
+    state = GameState::READY;
+}
+
+Save::Data Minefield::snapshot() const {
+    Save::Data data;
+    data.rows = rows;
+    data.cols = cols;
+    data.state = state;
+    data.seed = seed;
+    data.tiles.reserve(rows*cols);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            data.tiles.push_back(cells[r][c]);
+        }
+    }
+    return data;
+}
+
+void Minefield::restore(const Save::Data& data) {
+    restore(data.rows, data.cols, data.seed, data.state, data.tiles.data());
+}
+
+void Minefield::restore(int rows, int cols, uint32_t seed, uint8_t state, const uint8_t *tiles) {
+    this->rows = rows;
+    this->cols = cols;
+    this->seed = seed;
+    rng.seed(seed);
+    reset();
+
+    int mines = 0;
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            cells[r][c] = tiles[r*cols + c];
+            flags += isFlagged(r, c);
+            mines += isMine(r, c);
+        }
+    }
+    countNumbers();
+    this->state = state;
+    // Fewer mines than planned might have fit, only a game that hasn't started keeps the plan
+    if (state & GameState::STARTED) mineCount = mines;
+}
+
+void Minefield::copyCells(uint8_t *out) const {
+    for (int r = 0; r < rows; r++) {
+        std::copy(cells[r], cells[r] + cols, out + r*cols);
+    }
+}
+
+void Minefield::uncover(const std::vector<Flip>& flipped) {
+    for (auto& flip : flipped) {
+        set(flip.row, flip.col, TileSaveData::HIDDEN, false);
+    }
+}
+
+void Minefield::placeMine(int r, int c) {
+    set(r, c, TileSaveData::MINE, true);
+    foreachTouching(r, c, [this](int nr, int nc) {
+        numbers[nr][nc] += 1;
+    });
+}
+
+void Minefield::countNumbers() {
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            int nearbyMines = 0;
+            foreachTouching(r, c, [&](int nr, int nc) {
+                nearbyMines += isMine(nr, nc);
+            });
+            numbers[r][c] = nearbyMines;
+        }
+    }
+}
+
+bool Minefield::click(int r, int c, std::vector<Flip>& flipped) {
+    if (!isClickable(r, c)) return false;
+
+    if (state & GameState::STARTED) {
+        flip(r, c, true, 0, flipped);
+        onReveal(r, c, flipped);
+    } else {
+        generateStartingArea(r, c, flipped);
+        state |= GameState::STARTED;
+    }
+    return true;
+}
+
+bool Minefield::toggleFlag(int r, int c) {
+    if (state & GameState::OVER) return false;
+    if (!isHidden(r, c)) return false;
+
+    const bool flagged = !isFlagged(r, c);
+    set(r, c, TileSaveData::FLAGGED, flagged);
+    flags += flagged ? 1 : -1;
+    return true;
+}
+
+bool Minefield::cellAt(int x, int y, int originX, int originY, int size, int& r, int& c) const {
+    const int dx = x - originX;
+    const int dy = y - originY;
+    if (dx <= 0 || dy <= 0 || dx % size == 0 || dy % size == 0) return false;
+
+    r = dy / size;
+    c = dx / size;
+    return r < rows && c < cols;
+}
+
+void Minefield::flip(int r, int c, bool recurse, uint32_t delay, std::vector<Flip>& flipped) {
+    set(r, c, TileSaveData::HIDDEN, false);
+    flipped.push_back({r, c, delay});
+
+    if (!isMine(r, c) && recurse && countTouchingMines(r, c) == 0) {
+        // Recursively reveal surrounding tiles
+        foreachTouching(r, c, [&](int nr, int nc) {
+            if (isHidden(nr, nc)) {
+                flip(nr, nc, recurse, delay += 100, flipped);
+            }
+        });
+    }
+}
+
+void Minefield::onReveal(int r, int c, std::vector<Flip>& flipped) {
+    if (isMine(r, c)) {
+        onLost(r, c, flipped);
+    }
+    else if (hasWon()) {
+        onWon();
+    }
+}
+
+void Minefield::onLost(int r, int c, std::vector<Flip>& flipped) {
+    state |= GameState::LOST;
+    set(r, c, TileSaveData::RED, true);
+
+    std::vector<Flip> mines;
+    for (int mr = 0; mr < rows; mr++) {
+        for (int mc = 0; mc < cols; mc++) {
+            if (isMine(mr, mc) && !isFlagged(mr, mc)) {
+                mines.push_back({mr, mc, 0});
+            }
+        }
+    }
+    std::sort(mines.begin(), mines.end(), [r, c](const Flip& a, const Flip& b) {
+        const int aDistSq = (a.row - r)*(a.row - r) + (a.col - c)*(a.col - c);
+        const int bDistSq = (b.row - r)*(b.row - r) + (b.col - c)*(b.col - c);
+        return aDistSq < bDistSq;
+    });
+
+    const uint32_t deltaDelay = MINE_REVEAL_MILLISECONDS / mines.size();
+    uint32_t delay = 0;
+
+    // Skip first item, the detonated mine
+    for (auto it = mines.begin() + 1; it != mines.end(); ++it) {
+        flip(it->row, it->col, false, delay, flipped);
+        delay += deltaDelay;
+    }
+
+    for (int fr = 0; fr < rows; fr++) {
+        for (int fc = 0; fc < cols; fc++) {
+            if (!isMine(fr, fc) && isFlagged(fr, fc)) {
+                // Incorrect flag
+                set(fr, fc, TileSaveData::RED, true);
+            }
+        }
+    }
+}
+
+void Minefield::onWon() {
+    state |= GameState::WON;
+
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            if (isMine(r, c)) {
+                set(r, c, TileSaveData::REMOVED, true);
+            }
+        }
+    }
+}
+
+static void pushHiddenNeighbors(const Minefield& field, int r, int c, std::vector<Minefield::Flip>& cells, bool diagonals) {
+    field.foreachTouching(r, c, [&](int nr, int nc) {
+        for (auto& cell : cells) if (cell.row == nr && cell.col == nc) return;
+        if (field.isHidden(nr, nc)) {
+            cells.push_back({nr, nc, 0});
+        }
+    }, diagonals);
+}
+
+void Minefield::flipTiles(int row, int col, int count, std::vector<Flip>& revealqueue) {
+    std::vector<Flip> tiles;
+    std::vector<Flip> tospread;
+
+    // Start by adding all neighbors, including diagonals
+    pushHiddenNeighbors(*this, row, col, tiles, true);
+
+    while (count > 0 && !tiles.empty()) {
+        // Select up to N random neighbors
+        std::shuffle(tiles.begin(), tiles.end(), rng);
+        int num = std::min(int(std::min((long unsigned)tiles.size(), 8UL)), count);
+
+        for (int i = 0; i < num; ++i) {
+            count -= 1;
+            // Clear hidden now so the layers don't overlap,
+            // the cells are flipped once the mines are placed
+            set(tiles[i].row, tiles[i].col, TileSaveData::HIDDEN, false);
+
+            revealqueue.push_back(tiles[i]);
+
+            // Add for hidden neighbors to be in next potential layer
+            tospread.push_back(tiles[i]);
+        }
+
+        tiles.clear();
+
+        // Build next layer
+        for (auto& tile : tospread) {
+            pushHiddenNeighbors(*this, tile.row, tile.col, tiles, false);
+        }
+        tospread.clear();
+    }
+}
+
+void Minefield::generateStartingArea(int r, int c, std::vector<Flip>& flipped) {
+    std::vector<Flip> toreveal;
+
+    toreveal.push_back({r, c, 0});
+
+    set(r, c, TileSaveData::HIDDEN, false);
+    set(r, c, TileSaveData::MINE, false);
+
+    flipTiles(r, c, STARTING_SAFE_COUNT, toreveal);
+
+    generateMines();
+    uint32_t delay = 0;
+    for (auto& tile : toreveal) {
+        flip(tile.row, tile.col, true, delay, flipped);
+        delay += FLIP_DELAY;
+    }
+
+    onReveal(r, c, flipped);
+}
+
+void Minefield::generateMines() {
+    std::uniform_int_distribution<> randrow(0, rows);
+    std::uniform_int_distribution<> randcol(0, cols);
+    for (int i = 0; i < mineCount; ++i) {
+        int rowPicked = randrow(rng);
+        int colPicked = randcol(rng);
+
+        // Find first available tile, starting from the selected position
+        // and working our way around as if it's a circular array
+        bool found = false;
+        for (int _r = 0; _r < rows && !found; ++_r)
+        for (int _c = 0; _c < cols && !found; ++_c) {
+            int r = (_r + rowPicked) % rows;
+            int c = (_c + colPicked) % cols;
+
+            if (isHidden(r, c) && !isMine(r, c)) {
+                placeMine(r, c);
+                found = true;
+            }
+        }
+
+        if (!found) {
+            // No free tiles left
+            mineCount = i;
+            break;
+        }
+    }
+}
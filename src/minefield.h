@@ -0,0 +1,143 @@
+#ifndef MINEFIELD_H
+#define MINEFIELD_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "save.h"
+
+// Rules of the game without any SDL, textures or animations, so they can
+// be driven headless (see tools/fuzz.cpp). Game is the playable front of it.
+
+#define MAX_FIELD_SIZE 50
+
+enum GameState {
+    READY = 0,
+    STARTED = 1,
+    WON = 2,
+    LOST = 4,
+    OVER = WON | LOST,
+};
+
+// Bits of a cell, also what is saved for every tile
+namespace TileSaveData {
+    enum {
+        HIDDEN  = 1,
+        MINE    = 2,
+        FLAGGED = 4,
+        RED     = 8,
+        REMOVED = 16,
+
+        DEFAULT = HIDDEN,
+    };
+}
+
+class Minefield {
+public:
+    // A cell that was revealed, in the order they were revealed,
+    // and how long its animation should wait in milliseconds
+    struct Flip {
+        int row;
+        int col;
+        uint32_t delay;
+    };
+
+    explicit Minefield(uint32_t seed);
+
+    int rows, cols;
+
+    uint32_t seed;
+    std::mt19937 rng;
+
+    int mineCount;
+    int state;
+
+    [[nodiscard]] uint8_t cell(int r, int c) const { return cells[r][c]; }
+    [[nodiscard]] bool isMine(int r, int c) const { return cells[r][c] & TileSaveData::MINE; }
+    [[nodiscard]] bool isHidden(int r, int c) const { return cells[r][c] & TileSaveData::HIDDEN; }
+    [[nodiscard]] bool isFlagged(int r, int c) const { return cells[r][c] & TileSaveData::FLAGGED; }
+    [[nodiscard]] bool isRed(int r, int c) const { return cells[r][c] & TileSaveData::RED; }
+    [[nodiscard]] bool isRemoved(int r, int c) const { return cells[r][c] & TileSaveData::REMOVED; }
+    [[nodiscard]] bool isClickable(int r, int c) const;
+
+    // Kept up to date as mines are placed instead of counted every frame
+    [[nodiscard]] int countTouchingMines(int r, int c) const { return numbers[r][c]; }
+    [[nodiscard]] int flagCount() const { return flags; }
+    // All cells that aren't mines have been revealed
+    [[nodiscard]] bool hasWon() const;
+
+    // Clear the board for a new game of rows x cols
+    void reset();
+
+    Save::Data snapshot() const;
+    // Take over a decoded save, its size must be below MAX_FIELD_SIZE
+    void restore(const Save::Data& data);
+    // Same without a Save::Data, from rows * cols TileSaveData bytes
+    void restore(int rows, int cols, uint32_t seed, uint8_t state, const uint8_t *tiles);
+    // The rows * cols TileSaveData bytes of the board, row major
+    void copyCells(uint8_t *out) const;
+    // Reveal cells another copy of the board flipped, without the rules
+    void uncover(const std::vector<Flip>& flipped);
+
+    // Reveal a cell, the first click of a game builds the starting area.
+    // Returns false if the cell can't be clicked.
+    bool click(int r, int c, std::vector<Flip>& flipped);
+    // Flag or unflag a hidden cell. Returns false if nothing changed
+    bool toggleFlag(int r, int c);
+
+    // Place up to mineCount mines on hidden safe cells, lowering
+    // mineCount if they don't all fit
+    void generateMines();
+
+    // Cell under the point (x, y) of the board drawn at (originX, originY)
+    // with cells of `size` pixels. Points on the lines between cells miss
+    bool cellAt(int x, int y, int originX, int originY, int size, int& r, int& c) const;
+
+    template <typename F>
+    void foreachTouching(int r, int c, F callback, bool diagonals = true) const;
+
+private:
+    uint8_t cells[MAX_FIELD_SIZE][MAX_FIELD_SIZE];
+    uint8_t numbers[MAX_FIELD_SIZE][MAX_FIELD_SIZE];
+    int flags;
+
+    void set(int r, int c, uint8_t bit, bool on);
+    void placeMine(int r, int c);
+    void countNumbers();
+
+    void flip(int r, int c, bool recurse, uint32_t delay, std::vector<Flip>& flipped);
+    void flipTiles(int r, int c, int count, std::vector<Flip>& revealqueue);
+    void generateStartingArea(int r, int c, std::vector<Flip>& flipped);
+    void onReveal(int r, int c, std::vector<Flip>& flipped);
+    void onLost(int r, int c, std::vector<Flip>& flipped);
+    void onWon();
+};
+
+template <typename F>
+void Minefield::foreachTouching(int row, int col, F callback, bool diagonals) const {
+    const int left = col - 1;
+    const int right = col + 1;
+    const int below = row + 1;
+    const int above = row - 1;
+
+    const bool spaceLeft = left >= 0;
+    const bool spaceRight = right < cols;
+    const bool spaceAbove = above >= 0;
+    const bool spaceBelow = below < rows;
+
+    // Reveal order depends on this order
+    if (spaceLeft) callback(row, left);
+    if (spaceRight) callback(row, right);
+    if (spaceAbove) callback(above, col);
+    if (spaceBelow) callback(below, col);
+
+    if (diagonals) {
+        if (spaceLeft && spaceAbove) callback(above, left);
+        if (spaceRight && spaceAbove) callback(above, right);
+        if (spaceLeft && spaceBelow) callback(below, left);
+        if (spaceRight && spaceBelow) callback(below, right);
+    }
+}
+
+#endif
@@ -1,40 +1,71 @@
 #include <SDL_render.h>
 #include <SDL_ttf.h>
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include "game.h"
 #include "app.h"
 #include "color.h"
 #include "frontend.h"
+#include "backend.h"
+#include "autosave.h"
 
-static SDL_RWops *rw;
+// Milliseconds between autosaves
+constexpr Uint32 AUTOSAVE_PERIOD = 3000;
+
+// Set between openSaveWriter and closeSaveFile
+static bool writing;
+static std::vector<Uint8> buffer;
+static size_t readPos;
 std::string save_file_path;
+static Autosaver autosaver;
+static Uint32 lastAutosave;
 
 bool openSaveReader(void) {
-    rw = SDL_RWFromFile(save_file_path.c_str(), "r+b");
-    if (rw == NULL) {
+    SDL_RWops *file = SDL_RWFromFile(save_file_path.c_str(), "rb");
+    if (file == NULL) {
         fprintf(stderr, "Error opening save save_file_path for reading (%s)\n", SDL_GetError());
         return false;
     }
-    return rw != NULL;
+    Sint64 size = SDL_RWsize(file);
+    buffer.resize(size > 0 ? size : 0);
+    buffer.resize(SDL_RWread(file, buffer.data(), 1, buffer.size()));
+    SDL_RWclose(file);
+    readPos = 0;
+    return true;
 }
 bool openSaveWriter(void) {
-    rw = SDL_RWFromFile(save_file_path.c_str(), "w+b");
-    if (rw == NULL) {
-        fprintf(stderr, "Error opening save save_file_path for writing (%s)\n", SDL_GetError());
-        return false;
-    }
-    return rw != NULL;
+    writing = true;
+    buffer.clear();
+    return true;
 }
 Uint8 readByte(void) {
-    return SDL_ReadU8(rw);
+    // Reads past the end give 0 like SDL_ReadU8
+    return readPos < buffer.size() ? buffer[readPos++] : 0;
+}
+size_t readBytes(Uint8 *data, size_t size) {
+    size = SDL_min(size, buffer.size() - readPos);
+    SDL_memcpy(data, buffer.data() + readPos, size);
+    readPos += size;
+    return size;
 }
 int writeByte(Uint8 value) {
-    return SDL_WriteU8(rw, value);
+    buffer.push_back(value);
+    return 1;
+}
+size_t writeBytes(const Uint8 *data, size_t size) {
+    buffer.insert(buffer.end(), data, data + size);
+    return size;
 }
 void closeSaveFile(void) {
-    SDL_RWclose(rw);
-    rw = NULL;
+    if (writing) {
+        // This save is newer than any autosave still in flight
+        autosaver.cancel();
+        writeFileAtomic(save_file_path, save_file_path + ".tmp", buffer.data(), buffer.size());
+        writing = false;
+    }
+    buffer.clear();
+    readPos = 0;
 }
 
 void frontend_init(char **arg) {
@@ -54,4 +85,18 @@ void frontend_init(char **arg) {
         SDL_free(dir);
     }
     printf("Save path: %s\n", save_file_path.c_str());
+    autosaver.start(save_file_path);
+}
+
+void frontend_update(void) {
+    // The snapshot is cheap, encoding and writing happen on the worker
+    const Uint32 now = SDL_GetTicks();
+    if (now - lastAutosave >= AUTOSAVE_PERIOD) {
+        lastAutosave = now;
+        autosaver.submit(snapshotGame());
+    }
+}
+
+void frontend_quit(void) {
+    autosaver.stop();
 }
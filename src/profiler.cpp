@@ -0,0 +1,150 @@
+#include "profiler.h"
+#include "audio.h"
+#include "latency.h"
+#include "app.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace Overlay {
+    // Seconds between text updates
+    constexpr double REFRESH_PERIOD = 0.5;
+    constexpr double TEXT_SCALE = 0.35;
+    constexpr int MARGIN = 6;
+    const Color BACKGROUND { 0x000000, 0.7 };
+    const Color FOREGROUND { 0xFFFFFF };
+}
+
+static const char *PHASE_NAMES[Phase::COUNT] = {
+    "events",
+    "board",
+    "anims",
+    "ui",
+    "present",
+};
+
+FrameProfiler Profiler;
+
+FrameProfiler::FrameProfiler()
+    : visible(false)
+    , frameTimes{}
+    , frameCount(0)
+    , frameStart(0)
+    , phaseCounts{}
+    , phaseFrames(0)
+    , lastFrameMs(0)
+    , drawCalls(0)
+    , lastDrawCalls(0)
+    , textureSwitches(0)
+    , lastSwitches(0)
+    , lastTexture(nullptr)
+    , activeAnims(0)
+    , lastRefresh(0)
+{}
+
+void FrameProfiler::beginFrame() {
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if (frameStart) {
+        const double ms = (now - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        frameTimes[frameCount % HISTORY] = ms;
+        frameCount += 1;
+        lastFrameMs = ms;
+    }
+    frameStart = now;
+
+    lastDrawCalls = drawCalls;
+    drawCalls = 0;
+    lastSwitches = textureSwitches;
+    textureSwitches = 0;
+    lastTexture = nullptr;
+    if (visible) phaseFrames += 1;
+}
+
+static float percentile(std::vector<float>& times, double p) {
+    auto nth = times.begin() + size_t(p * (times.size() - 1));
+    std::nth_element(times.begin(), nth, times.end());
+    return *nth;
+}
+
+void FrameProfiler::refresh(TTF_Font *font) {
+    using namespace Overlay;
+
+    const int count = std::min(frameCount, HISTORY);
+    std::vector<float> times(frameTimes, frameTimes + count);
+    if (times.empty()) times.push_back(0.0);
+
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const int frames = std::max(phaseFrames, 1);
+
+    char buf[128];
+    std::vector<std::string> strings;
+
+    snprintf(buf, sizeof(buf), "frame ms  p50 %.1f  p95 %.1f  p99 %.1f  max %.1f",
+             percentile(times, 0.5), percentile(times, 0.95), percentile(times, 0.99),
+             *std::max_element(times.begin(), times.end()));
+    strings.push_back(buf);
+
+    std::string phases = "phase ms ";
+    for (int i = 0; i < Phase::COUNT; ++i) {
+        snprintf(buf, sizeof(buf), " %s %.2f", PHASE_NAMES[i], phaseCounts[i] * 1000.0 / freq / frames);
+        phases += buf;
+        phaseCounts[i] = 0;
+    }
+    phaseFrames = 0;
+    strings.push_back(phases);
+
+    snprintf(buf, sizeof(buf), "draw calls %d  texture switches %d  active anims %d", lastDrawCalls, lastSwitches, activeAnims);
+    strings.push_back(buf);
+
+    if (Audio::latency() >= 0) {
+        snprintf(buf, sizeof(buf), "audio latency %.0f ms  buffer %d", Audio::latency(), Audio::bufferSamples());
+    }
+    else {
+        snprintf(buf, sizeof(buf), "audio latency -  buffer %d", Audio::bufferSamples());
+    }
+    strings.push_back(buf);
+
+    const char *mode = Sim.lowLatency ? "low latency" : "vsync";
+    double p50, p99, max;
+    if (Latency::stats(p50, p99, max)) {
+        snprintf(buf, sizeof(buf), "input latency ms  p50 %.1f  p99 %.1f  max %.1f  %s", p50, p99, max, mode);
+    }
+    else {
+        snprintf(buf, sizeof(buf), "input latency -  %s", mode);
+    }
+    strings.push_back(buf);
+
+    while (lines.size() < strings.size()) lines.emplace_back(font);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        lines[i].setColor(FOREGROUND);
+        lines[i].setScale(TEXT_SCALE);
+        lines[i].setString(strings[i]);
+    }
+}
+
+void FrameProfiler::render(TTF_Font *font) {
+    using namespace Overlay;
+
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if (lines.empty() || (now - lastRefresh) >= REFRESH_PERIOD * SDL_GetPerformanceFrequency()) {
+        lastRefresh = now;
+        refresh(font);
+    }
+
+    int width = 0;
+    int height = MARGIN;
+    for (auto& line : lines) {
+        line.load();
+        line.x = MARGIN;
+        line.y = height;
+        width = std::max(width, line.getWidth());
+        height += line.getHeight();
+    }
+
+    BACKGROUND.draw();
+    SDL_Rect background { 0, 0, width + MARGIN * 2, height + MARGIN };
+    SDL_RenderFillRect(renderer, &background);
+
+    for (auto& line : lines) {
+        line.render();
+    }
+}
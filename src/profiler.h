@@ -0,0 +1,93 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <SDL_render.h>
+#include <SDL_timer.h>
+#include <SDL_ttf.h>
+#include <vector>
+#include "text.h"
+
+namespace Phase {
+    enum {
+        EVENTS     = 0,
+        BOARD      = 1,
+        ANIMATIONS = 2,
+        BUTTONS    = 3,
+        PRESENT    = 4,
+        COUNT,
+    };
+}
+
+// Frame timing overlay, toggled with F3
+// While hidden only the frame time and draw call counter are recorded,
+// phase timing is skipped
+class FrameProfiler {
+public:
+    FrameProfiler();
+
+    bool visible;
+    void toggle() { visible = !visible; }
+
+    // Call at the start of every frame
+    void beginFrame();
+
+    void addPhase(int phase, Uint64 counts) { phaseCounts[phase] += counts; }
+    // Pass the texture drawn from, to count switches between textures
+    void countDraw(const SDL_Texture *texture = nullptr) {
+        drawCalls += 1;
+        if (texture && texture != lastTexture) {
+            textureSwitches += 1;
+            lastTexture = texture;
+        }
+    }
+    void countAnims(int count) { activeAnims = count; }
+
+    // Stats of the last completed frame
+    [[nodiscard]] float lastFrameTime() const { return lastFrameMs; }
+    [[nodiscard]] int lastDraws() const { return lastDrawCalls; }
+    [[nodiscard]] int lastTextureSwitches() const { return lastSwitches; }
+
+    void render(TTF_Font *font);
+
+private:
+    static constexpr int HISTORY = 240;
+    float frameTimes[HISTORY];
+    int frameCount;
+    Uint64 frameStart;
+
+    Uint64 phaseCounts[Phase::COUNT];
+    int phaseFrames;
+    float lastFrameMs;
+    int drawCalls;
+    int lastDrawCalls;
+    int textureSwitches;
+    int lastSwitches;
+    const SDL_Texture *lastTexture;
+    int activeAnims;
+
+    Uint64 lastRefresh;
+    std::vector<Text> lines;
+    void refresh(TTF_Font *font);
+};
+
+extern FrameProfiler Profiler;
+
+// Adds the time until the end of the scope to a phase
+class ProfileScope {
+public:
+    ProfileScope(int phase)
+        : phase(phase), start(Profiler.visible ? SDL_GetPerformanceCounter() : 0) {}
+    ~ProfileScope() { stop(); }
+
+    // End the measurement early
+    void stop() {
+        if (start) Profiler.addPhase(phase, SDL_GetPerformanceCounter() - start);
+        start = 0;
+    }
+
+private:
+    int phase;
+    Uint64 start;
+};
+
+#endif
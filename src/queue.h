@@ -0,0 +1,104 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Slots are reused, so T must be default constructible and movable.
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer only. Returns false and leaves `value` alone if the queue is full
+    bool push(T&& value) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAPACITY) return false;
+        slots[t & (CAPACITY - 1)] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty
+    bool pop(T& out) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        out = std::move(slots[h & (CAPACITY - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T slots[CAPACITY];
+    // Apart so the two threads don't share a cache line
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+// Bounded lock-free queue for any number of producer threads and one
+// consumer thread. Every slot has a sequence number that tells producers
+// whether it's free and the consumer whether it's filled.
+template <typename T, size_t CAPACITY>
+class MpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    MpscQueue() : head(0), tail(0) {
+        for (size_t i = 0; i < CAPACITY; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread. Returns false and leaves `value` alone if the queue is full
+    bool push(T&& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[t & (CAPACITY - 1)];
+            const intptr_t diff = intptr_t(slot.sequence.load(std::memory_order_acquire)) - intptr_t(t);
+            if (diff < 0) return false;
+            if (diff > 0) {
+                // Another producer took this slot
+                t = tail.load(std::memory_order_relaxed);
+            }
+            else if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+                slot.value = std::move(value);
+                slot.sequence.store(t + 1, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    // Consumer only. Returns false if the queue is empty or the next value
+    // is still being written
+    bool pop(T& out) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[h & (CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != h + 1) return false;
+        out = std::move(slot.value);
+        // Free for the producer that's a lap ahead
+        slot.sequence.store(h + CAPACITY, std::memory_order_release);
+        head.store(h + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Slot slots[CAPACITY];
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "save.h"
+#include "minefield.h"
+#include <cstring>
+
+const char Save::HEADER[] = "MINE ";
+const char Save::MAGIC[] = "MSAV";
+
+namespace {
+    constexpr size_t MAGIC_SIZE = 4;
+    // magic, version, rows, cols, state, seed, payload size
+    constexpr size_t FIXED_SIZE = MAGIC_SIZE + 1 + 2 + 2 + 1 + 4 + 4;
+    constexpr size_t CRC_SIZE = 4;
+
+    void put16(std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(value & 0xFF);
+        out.push_back((value >> 8) & 0xFF);
+    }
+
+    void put32(std::vector<uint8_t>& out, uint32_t value) {
+        put16(out, value & 0xFFFF);
+        put16(out, value >> 16);
+    }
+
+    void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(value);
+    }
+
+    uint32_t get16(const uint8_t *p) {
+        return p[0] | (p[1] << 8);
+    }
+
+    uint32_t get32(const uint8_t *p) {
+        return get16(p) | (get16(p + 2) << 16);
+    }
+
+    // Reads a varint from [p, end), returns false if it's cut off or too long
+    bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 32 && p < end; shift += 7) {
+            uint8_t byte = *p++;
+            value |= uint32_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    const char *decodeLegacy(const uint8_t *bytes, size_t size, Save::Data& out) {
+        const uint8_t *p = bytes + sizeof(Save::HEADER) - 1;
+        const uint8_t *end = bytes + size;
+
+        if (end - p < 6 || p[0] != 'r' || p[2] != 'c' || p[4] != 'g') {
+            return "missing board data";
+        }
+        out.rows = p[1];
+        out.cols = p[3];
+        out.state = p[5];
+        p += 6;
+        if (out.rows >= MAX_FIELD_SIZE || out.cols >= MAX_FIELD_SIZE) {
+            return "board too large";
+        }
+
+        const size_t count = size_t(out.rows) * out.cols;
+        // Tiles missing from the save stay hidden
+        out.tiles.assign(count, 1);
+        size_t i = 0;
+        while (end - p >= 2 && p[0] == 't') {
+            if (i >= count) return "too many tiles";
+            out.tiles[i++] = p[1];
+            p += 2;
+        }
+
+        if (end - p < 5 || p[0] != 'z') {
+            return "missing seed";
+        }
+        memcpy(&out.seed, p + 1, sizeof(out.seed));
+        return nullptr;
+    }
+}
+
+uint32_t Save::crc32(const uint8_t *bytes, size_t size) {
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+std::vector<uint8_t> Save::encode(const Data& data) {
+    std::vector<uint8_t> out(MAGIC, MAGIC + MAGIC_SIZE);
+    out.push_back(VERSION);
+    put16(out, data.rows);
+    put16(out, data.cols);
+    out.push_back(data.state);
+    put32(out, data.seed);
+
+    // Payload size is filled in once it's known
+    const size_t payloadSizePos = out.size();
+    put32(out, 0);
+
+    for (int plane = 0; plane < PLANES; ++plane) {
+        const uint8_t mask = 1 << plane;
+        bool bit = false;
+        uint32_t run = 0;
+        for (uint8_t tile : data.tiles) {
+            if (bool(tile & mask) != bit) {
+                putVarint(out, run);
+                bit = !bit;
+                run = 0;
+            }
+            run += 1;
+        }
+        putVarint(out, run);
+    }
+
+    const uint32_t payloadSize = out.size() - FIXED_SIZE;
+    for (int i = 0; i < 4; ++i) {
+        out[payloadSizePos + i] = (payloadSize >> (i * 8)) & 0xFF;
+    }
+
+    put32(out, crc32(out.data(), out.size()));
+    return out;
+}
+
+const char *Save::decode(const uint8_t *bytes, size_t size, Data& out) {
+    if (size >= sizeof(HEADER) - 1 && memcmp(bytes, HEADER, sizeof(HEADER) - 1) == 0) {
+        return decodeLegacy(bytes, size, out);
+    }
+
+    if (size < FIXED_SIZE + CRC_SIZE || memcmp(bytes, MAGIC, MAGIC_SIZE) != 0) {
+        return "not a save file";
+    }
+    if (bytes[MAGIC_SIZE] != VERSION) {
+        return "unsupported version";
+    }
+
+    const uint8_t *p = bytes + MAGIC_SIZE + 1;
+    out.rows = get16(p);
+    out.cols = get16(p + 2);
+    out.state = p[4];
+    out.seed = get32(p + 5);
+    const uint32_t payloadSize = get32(p + 9);
+    // Before anything is sized by them, the checksum is easy to fake
+    if (out.rows >= MAX_FIELD_SIZE || out.cols >= MAX_FIELD_SIZE) {
+        return "board too large";
+    }
+
+    // Check the size and checksum before touching the payload
+    if (payloadSize != size - FIXED_SIZE - CRC_SIZE) {
+        return "truncated";
+    }
+    if (crc32(bytes, size - CRC_SIZE) != get32(bytes + size - CRC_SIZE)) {
+        return "checksum mismatch";
+    }
+
+    const size_t count = size_t(out.rows) * out.cols;
+    out.tiles.assign(count, 0);
+
+    p = bytes + FIXED_SIZE;
+    const uint8_t *end = bytes + size - CRC_SIZE;
+    for (int plane = 0; plane < PLANES; ++plane) {
+        const uint8_t mask = 1 << plane;
+        bool bit = false;
+        size_t i = 0;
+        do {
+            uint32_t run;
+            if (!getVarint(p, end, run) || run > count - i) {
+                return "corrupted tile data";
+            }
+            if (bit) {
+                for (size_t j = i; j < i + run; ++j) out.tiles[j] |= mask;
+            }
+            i += run;
+            bit = !bit;
+        } while (i < count);
+    }
+    if (p != end) {
+        return "corrupted tile data";
+    }
+    return nullptr;
+}
@@ -0,0 +1,52 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Save file encoding, independent of SDL and the game objects.
+//
+// Version 2 layout, integers little endian:
+//   "MSAV"  magic
+//   u8      version
+//   u16     rows
+//   u16     cols
+//   u8      game state
+//   u32     seed
+//   u32     payload size
+//   ...     payload: one RLE bitplane per TileSaveData bit
+//   u32     CRC-32 of everything before it
+//
+// A bitplane is a sequence of run lengths as LEB128 varints, alternating
+// between runs of unset and set bits and starting with unset bits.
+// The runs of a plane add up to rows * cols.
+//
+// The legacy "MINE " format is still accepted by decode().
+namespace Save {
+    extern const char HEADER[];
+    extern const char MAGIC[];
+    constexpr uint8_t VERSION = 2;
+
+    // Number of bits used in a tile's TileSaveData byte
+    constexpr int PLANES = 5;
+
+    struct Data {
+        int rows = 0;
+        int cols = 0;
+        uint8_t state = 0;
+        uint32_t seed = 0;
+        // rows * cols TileSaveData bytes, row major
+        std::vector<uint8_t> tiles;
+    };
+
+    std::vector<uint8_t> encode(const Data& data);
+
+    // Returns nullptr on success, otherwise why the save was rejected.
+    // Boards of MAX_FIELD_SIZE rows or columns and up are rejected
+    const char *decode(const uint8_t *bytes, size_t size, Data& out);
+
+    uint32_t crc32(const uint8_t *bytes, size_t size);
+}
+
+#endif
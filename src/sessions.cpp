@@ -0,0 +1,211 @@
+#include "sessions.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+Arena::Arena(size_t chunkSize)
+    : chunkSize(chunkSize)
+    , chunkUsed(chunkSize)
+    , inUse(0)
+{}
+
+uint8_t *Arena::allocate(size_t size) {
+    assert(size <= chunkSize);
+    inUse += size;
+
+    auto blocks = freeBlocks.find(size);
+    if (blocks != freeBlocks.end() && !blocks->second.empty()) {
+        uint8_t *block = blocks->second.back();
+        blocks->second.pop_back();
+        return block;
+    }
+
+    if (chunkUsed + size > chunkSize) {
+        chunks.emplace_back(new uint8_t[chunkSize]);
+        chunkUsed = 0;
+    }
+    uint8_t *block = chunks.back().get() + chunkUsed;
+    chunkUsed += size;
+    return block;
+}
+
+void Arena::free(uint8_t *block, size_t size) {
+    inUse -= size;
+    freeBlocks[size].push_back(block);
+}
+
+SessionManager::SessionManager(size_t liveBytes)
+    : liveBytes(liveBytes)
+    , nextId(1)
+    , live(0)
+    , saved(0)
+    , scratch(0)
+    , loaded(0)
+{}
+
+void SessionManager::dispatch(const Command& command, Reply& reply) {
+    reply.error = nullptr;
+    reply.session = command.session;
+    reply.changed = false;
+    reply.flipped.clear();
+    reply.touching.clear();
+
+    if (command.type == Command::CREATE) {
+        if (command.rows < 1 || command.rows >= MAX_FIELD_SIZE || command.cols < 1 || command.cols >= MAX_FIELD_SIZE) {
+            reply.error = "board size out of range";
+            return;
+        }
+        const size_t size = command.rows * command.cols;
+        makeRoom(size);
+
+        Session& session = sessions[nextId];
+        session.rows = command.rows;
+        session.cols = command.cols;
+        session.state = GameState::READY;
+        session.seed = command.seed;
+        session.lastUsed = Clock::now();
+        session.cells = boards.allocate(size);
+        std::fill(session.cells, session.cells + size, TileSaveData::DEFAULT);
+        live += 1;
+
+        reply.session = nextId++;
+        reply.changed = true;
+    }
+
+    if (command.type == Command::CLOSE) {
+        auto it = sessions.find(command.session);
+        if (it == sessions.end()) {
+            reply.error = "no such session";
+            return;
+        }
+        Session& session = it->second;
+        if (session.cells) {
+            boards.free(session.cells, session.rows * session.cols);
+            live -= 1;
+        }
+        saved -= session.blob.size();
+        if (loaded == command.session) loaded = 0;
+        sessions.erase(it);
+        reply.changed = true;
+        return;
+    }
+
+    Session *session = open(reply.session, reply.error);
+    if (!session) return;
+
+    if (command.type == Command::CLICK || command.type == Command::FLAG) {
+        if (command.row < 0 || command.row >= scratch.rows || command.col < 0 || command.col >= scratch.cols) {
+            reply.error = "cell out of range";
+            return;
+        }
+        reply.changed = command.type == Command::CLICK
+            ? scratch.click(command.row, command.col, reply.flipped)
+            : scratch.toggleFlag(command.row, command.col);
+        if (reply.changed) writeBack(*session);
+        for (auto& flip : reply.flipped) {
+            reply.touching.push_back(scratch.isMine(flip.row, flip.col) ? -1 : scratch.countTouchingMines(flip.row, flip.col));
+        }
+    }
+
+    reply.state = scratch.state;
+    reply.flags = scratch.flagCount();
+    reply.mines = scratch.mineCount;
+}
+
+bool SessionManager::board(Id id, Save::Data& out) {
+    const char *error;
+    if (!open(id, error)) return false;
+    out = scratch.snapshot();
+    return true;
+}
+
+void SessionManager::evict(Id id) {
+    auto it = sessions.find(id);
+    if (it != sessions.end()) evict(id, it->second);
+}
+
+size_t SessionManager::evictIdle(Clock::duration idle) {
+    const Clock::time_point before = Clock::now() - idle;
+    size_t count = 0;
+    for (auto& entry : sessions) {
+        if (entry.second.cells && entry.second.lastUsed < before) {
+            evict(entry.first, entry.second);
+            count += 1;
+        }
+    }
+    return count;
+}
+
+// Puts the session on the scratch board, unless it's still there from its last command
+SessionManager::Session *SessionManager::open(Id id, const char *&error) {
+    auto it = sessions.find(id);
+    if (it == sessions.end()) {
+        error = "no such session";
+        return nullptr;
+    }
+    Session& session = it->second;
+    session.lastUsed = Clock::now();
+    if (loaded == id) return &session;
+
+    if (!session.cells) revive(session);
+    scratch.restore(session.rows, session.cols, session.seed, session.state, session.cells);
+    loaded = id;
+    return &session;
+}
+
+void SessionManager::revive(Session& session) {
+    Save::Data data;
+    if (const char *error = Save::decode(session.blob.data(), session.blob.size(), data)) {
+        // Only ever encoded by evict(), so this is a bug
+        fprintf(stderr, "Reviving session failed: %s\n", error);
+        exit(1);
+    }
+    const size_t size = data.tiles.size();
+    makeRoom(size);
+    session.cells = boards.allocate(size);
+    std::copy(data.tiles.begin(), data.tiles.end(), session.cells);
+    live += 1;
+
+    saved -= session.blob.size();
+    std::vector<uint8_t>().swap(session.blob);
+}
+
+void SessionManager::evict(Id id, Session& session) {
+    if (!session.cells) return;
+    Save::Data data;
+    data.rows = session.rows;
+    data.cols = session.cols;
+    data.state = session.state;
+    data.seed = session.seed;
+    data.tiles.assign(session.cells, session.cells + session.rows * session.cols);
+    session.blob = Save::encode(data);
+    saved += session.blob.size();
+
+    boards.free(session.cells, data.tiles.size());
+    session.cells = nullptr;
+    live -= 1;
+    if (loaded == id) loaded = 0;
+}
+
+void SessionManager::makeRoom(size_t bytes) {
+    if (live == 0 || boards.bytesInUse() + bytes <= liveBytes) return;
+
+    std::vector<std::pair<Clock::time_point, Id>> used;
+    used.reserve(live);
+    for (auto& entry : sessions) {
+        if (entry.second.cells) used.emplace_back(entry.second.lastUsed, entry.first);
+    }
+    // A quarter at once so a full manager doesn't scan every session per new board
+    auto oldest = used.begin() + std::max<size_t>(1, used.size() / 4);
+    std::nth_element(used.begin(), oldest - 1, used.end());
+    for (auto it = used.begin(); it != oldest; ++it) {
+        evict(it->second, sessions[it->second]);
+    }
+    makeRoom(bytes);
+}
+
+void SessionManager::writeBack(Session& session) {
+    scratch.copyCells(session.cells);
+    session.state = scratch.state;
+}
@@ -0,0 +1,137 @@
+#ifndef SESSIONS_H
+#define SESSIONS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "minefield.h"
+#include "save.h"
+
+// Fixed size blocks carved out of large chunks. A freed block goes back
+// to a free list for its size and is reused by the next board of the same
+// size, which is the usual case when every session plays one difficulty.
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    uint8_t *allocate(size_t size);
+    void free(uint8_t *block, size_t size);
+
+    // Bytes handed out and not freed
+    [[nodiscard]] size_t bytesInUse() const { return inUse; }
+    // Bytes taken from the system, including free blocks
+    [[nodiscard]] size_t bytesReserved() const { return chunks.size() * chunkSize; }
+
+private:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+    size_t chunkSize;
+    std::vector<std::unique_ptr<uint8_t[]>> chunks;
+    // Bytes used of the last chunk
+    size_t chunkUsed;
+    size_t inUse;
+    std::unordered_map<size_t, std::vector<uint8_t*>> freeBlocks;
+};
+
+// Hosts many independent games in one process, without SDL, for example
+// for a bot arena. A live session keeps one byte per cell in the Arena and
+// its moves are played on a single scratch Minefield. When the live boards
+// outgrow their budget, or a session sits idle, it's evicted to its save
+// encoding and revived on its next command.
+// Not thread safe, drive it from one thread.
+class SessionManager {
+public:
+    using Id = uint32_t;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t DEFAULT_LIVE_BYTES = 8 * 1024 * 1024;
+
+    struct Command {
+        enum Type {
+            // New game of rows x cols from `seed`, the reply has its id
+            CREATE,
+            CLICK,
+            FLAG,
+            // Only fills in the state, flags and mines of the reply
+            QUERY,
+            CLOSE,
+        };
+
+        Type type;
+        Id session;
+        int row, col;
+        int rows, cols;
+        uint32_t seed;
+    };
+
+    struct Reply {
+        // nullptr if the command was carried out, otherwise why not
+        const char *error;
+        Id session;
+        // Whether the move did anything
+        bool changed;
+        int state;
+        int flags;
+        int mines;
+        // Cells a CLICK revealed, in reveal order
+        std::vector<Minefield::Flip> flipped;
+        // Mines touching each of those cells, -1 for a mine
+        std::vector<int8_t> touching;
+    };
+
+    // Boards above `liveBytes` of cells in total are evicted, least recently used first
+    explicit SessionManager(size_t liveBytes = DEFAULT_LIVE_BYTES);
+
+    // Reuses the reply's vector, so a caller that keeps one reply doesn't allocate per move
+    void dispatch(const Command& command, Reply& reply);
+
+    // Board of a session. Returns false if there's no such session
+    bool board(Id id, Save::Data& out);
+
+    // Evict the session now, the next command revives it
+    void evict(Id id);
+    // Evict every session unused for `idle`, returns how many
+    size_t evictIdle(Clock::duration idle);
+
+    [[nodiscard]] size_t sessionCount() const { return sessions.size(); }
+    [[nodiscard]] size_t liveCount() const { return live; }
+    [[nodiscard]] const Arena& arena() const { return boards; }
+    // Bytes of the save encodings of evicted sessions
+    [[nodiscard]] size_t savedBytes() const { return saved; }
+
+private:
+    struct Session {
+        uint16_t rows, cols;
+        uint8_t state;
+        uint32_t seed;
+        Clock::time_point lastUsed;
+        // rows * cols cells in the arena while live, nullptr once evicted
+        uint8_t *cells;
+        // Save encoding while evicted
+        std::vector<uint8_t> blob;
+    };
+
+    size_t liveBytes;
+    Arena boards;
+    std::unordered_map<Id, Session> sessions;
+    Id nextId;
+    size_t live;
+    size_t saved;
+
+    Minefield scratch;
+    // Session the scratch board holds, 0 for none
+    Id loaded;
+
+    Session *open(Id id, const char *&error);
+    void revive(Session& session);
+    void evict(Id id, Session& session);
+    // Evict the least recently used quarter of the live sessions until `bytes` more fit
+    void makeRoom(size_t bytes);
+    void writeBack(Session& session);
+};
+
+#endif
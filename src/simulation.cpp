@@ -0,0 +1,144 @@
+#include "simulation.h"
+#include "trace.h"
+
+Simulation::Simulation(uint32_t seed)
+    : field(seed)
+    , stopping(false)
+    , submitted(0)
+    , completed(0)
+    , polled(0)
+    , published(nullptr)
+    , taken(nullptr)
+{}
+
+Simulation::~Simulation() {
+    stop();
+    destroy(published.exchange(nullptr));
+    destroy(taken);
+}
+
+void Simulation::destroy(Result *list) {
+    while (list) {
+        std::unique_ptr<const Result> result(list);
+        list = list->next;
+    }
+}
+
+void Simulation::start() {
+#ifndef __EMSCRIPTEN__
+    stopping = false;
+    worker = std::thread(&Simulation::run, this);
+#endif
+}
+
+void Simulation::stop() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void Simulation::submit(Move move) {
+    submitted += 1;
+    if (!isThreaded()) {
+        execute(move);
+        return;
+    }
+
+    while (!moves.push(std::move(move))) {
+        std::this_thread::yield();
+    }
+    // Taken so the thread can't miss the move between checking and sleeping
+    { std::lock_guard<std::mutex> lock(mutex); }
+    wake.notify_one();
+}
+
+bool Simulation::poll(std::unique_ptr<const Result>& result) {
+    if (!taken) {
+        // Take everything published so far at once and put it back in order
+        Result *newest = published.exchange(nullptr, std::memory_order_acquire);
+        while (newest) {
+            Result *next = newest->next;
+            newest->next = taken;
+            taken = newest;
+            newest = next;
+        }
+        if (!taken) return false;
+    }
+    result.reset(taken);
+    taken = taken->next;
+    polled += 1;
+    return true;
+}
+
+void Simulation::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return completed == submitted; });
+}
+
+Save::Data Simulation::snapshot() {
+    // The thread doesn't touch the board again until the next submit
+    wait();
+    return field.snapshot();
+}
+
+void Simulation::run() {
+    Move move;
+    for (;;) {
+        if (moves.pop(move)) {
+            execute(move);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return !moves.empty() || stopping; });
+        if (moves.empty()) break;
+    }
+}
+
+void Simulation::execute(Move& move) {
+    const int prevState = field.state;
+    std::vector<Minefield::Flip> flipped;
+    bool changed = true;
+
+    switch (move.type) {
+    case Move::CLICK: {
+        // The first click generates the board, later ones may reveal a large opening
+        TRACE_SCOPE(field.state & GameState::STARTED ? "Minefield::click" : "Minefield::generateStartingArea");
+        changed = field.click(move.row, move.col, flipped);
+        break;
+    }
+    case Move::FLAG:
+        changed = field.toggleFlag(move.row, move.col);
+        break;
+    case Move::RESET:
+        field.rows = move.rows;
+        field.cols = move.cols;
+        if (move.reseed) field.seed = field.rng();
+        field.reset();
+        break;
+    case Move::RESTORE:
+        field.restore(move.data);
+        break;
+    }
+
+    std::unique_ptr<const Save::Data> board;
+    if (move.type == Move::RESET || move.type == Move::RESTORE || field.state != prevState) {
+        board.reset(new Save::Data(field.snapshot()));
+    }
+    Result *result = new Result {
+        move.type, move.row, move.col, changed, prevState, std::move(flipped), std::move(board), nullptr,
+    };
+    result->next = published.load(std::memory_order_relaxed);
+    while (!published.compare_exchange_weak(result->next, result, std::memory_order_release,
+                                            std::memory_order_relaxed)) {}
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        completed += 1;
+    }
+    idle.notify_all();
+}
@@ -0,0 +1,111 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "minefield.h"
+#include "queue.h"
+#include "save.h"
+
+// Runs the Minefield on its own thread so a slow move, like revealing a
+// huge opening, never holds up rendering or input.
+// Moves come in through a lock-free queue from the thread that owns the
+// Game. After each one the thread publishes an immutable Result, which
+// the Game takes over without locking and replays on its own board.
+// Results are pushed on an atomic list without a bound, so the thread
+// never waits on the Game and a full move queue always drains.
+// The web build has no threads, there every move runs inside submit().
+class Simulation {
+public:
+    struct Move {
+        enum Type {
+            CLICK,
+            FLAG,
+            // New game of rows x cols, with a seed from the rng if `reseed`
+            RESET,
+            // Take over `data`
+            RESTORE,
+        };
+
+        Type type;
+        int row, col;
+        int rows, cols;
+        bool reseed;
+        Save::Data data;
+    };
+
+    struct Result {
+        Move::Type type;
+        int row, col;
+        // Whether the move did anything
+        bool changed;
+        int prevState;
+        std::vector<Minefield::Flip> flipped;
+        // The board after the move if it changed more than the flipped
+        // cells or a flag: new games, restores, and clicks that started,
+        // won or lost one. Null otherwise
+        std::unique_ptr<const Save::Data> board;
+        // Next result in the list it's published on
+        Result *next;
+    };
+
+    explicit Simulation(uint32_t seed);
+    ~Simulation();
+
+    void start();
+    // Finish the queued moves and join the thread
+    void stop();
+    [[nodiscard]] bool isThreaded() const { return worker.joinable(); }
+
+    // Called from one thread only
+    void submit(Move move);
+
+    // Takes the next published result, in the order the moves were submitted.
+    // Never blocks, returns false if there's none yet. Called from one thread only
+    bool poll(std::unique_ptr<const Result>& result);
+
+    // Block until every submitted move has been published. Safe to call from any thread
+    void wait();
+
+    // Moves submitted so far
+    [[nodiscard]] long submittedCount() const { return submitted; }
+    // Results taken by poll() so far, the same thread as poll()
+    [[nodiscard]] long polledCount() const { return polled; }
+
+    // Board after every submitted move, waits for them.
+    // Called from the thread that submits
+    Save::Data snapshot();
+
+private:
+    // Moves queued while the thread is busy, more wait in submit()
+    static constexpr size_t CAPACITY = 256;
+
+    Minefield field;
+    SpscQueue<Move, CAPACITY> moves;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool stopping;
+
+    std::atomic<long> submitted;
+    // Guarded by `mutex`, for wait()
+    long completed;
+    long polled;
+    // Results published and not taken yet, newest first
+    std::atomic<Result*> published;
+    // Results taken from `published` and not polled yet, oldest first
+    Result *taken;
+
+    void run();
+    void execute(Move& move);
+    static void destroy(Result *list);
+};
+
+#endif
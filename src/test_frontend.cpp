@@ -1,17 +1,83 @@
 #include <SDL_events.h>
 #include <SDL_stdinc.h>
 #include <SDL_timer.h>
+#include <SDL_image.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdbool>
+#include <cstdlib>
 #include <fstream>
+#include <new>
+#include <vector>
+#include "app.h"
+#include "clock.h"
 #include "backend.h"
 #include "frontend.h"
+#include "minefield.h"
+#include "profiler.h"
 
 
+// Count every C++ allocation in testminesector, for the allocations per
+// frame of the render benchmark. SDL allocates with malloc and isn't counted
+static std::atomic<long> allocations {0};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
 constexpr uint32_t INTERVAL = 100;
 constexpr uint32_t AUTOQUIT_PERIOD = 5000;
 
-static enum { RUNNING, RECORDING, FINISHED } state;
+// Timing of the virtual time modes (fast, golden and bench)
+namespace Replay {
+    // Virtual milliseconds per frame
+    constexpr Uint32 FRAME_TICKS = 1000 / 60;
+    // Frames between recorded commands in golden mode, about INTERVAL
+    constexpr int COMMAND_FRAMES = 6;
+}
+
+namespace Golden {
+    // Frames after the last command to compare, covering the reveal
+    // animations, the detonation and the board once everything settled
+    constexpr int CAPTURE_FRAMES[] = { 15, 90, 480 };
+
+    // Channel difference at which a pixel counts as changed
+    constexpr int CHANNEL_TOLERANCE = 24;
+    // Fraction of changed pixels allowed before the test fails
+    constexpr double MAX_CHANGED = 0.01;
+}
+
+namespace RenderBench {
+    constexpr int DEFAULT_FRAMES = 300;
+    constexpr uint32_t SEED = 1;
+    // Hard difficulty
+    constexpr int HARD_ROWS = 15;
+    constexpr int HARD_COLS = 20;
+    // Nearly empty board, so one click reveals most of it
+    constexpr int CASCADE_ROWS = 30;
+    constexpr int CASCADE_COLS = 40;
+    constexpr int CASCADE_MINE_SPACING = 7;
+}
+
+// Queues more moves in one frame, on the wall clock, than the simulation
+// buffers, and checks every one of them was played
+namespace Flood {
+    // Flag toggles on one cell, odd so it ends up flagged
+    constexpr int TOGGLES = 1001;
+    constexpr int ROWS = 16;
+    constexpr int COLS = 30;
+    constexpr int ROW = 3;
+    constexpr int COL = 4;
+    // Frames for the restored board to be in place
+    constexpr int SETTLE_FRAMES = 10;
+}
+
+static enum { RUNNING, RECORDING, GOLDEN, BENCH, FLOOD, FINISHED } state;
 
 static struct {
     std::ofstream expected;
@@ -23,10 +89,43 @@ static struct {
     std::ifstream sim_input;
     bool completed;
     bool succeeded;
+    // Apply every command at once instead of on a timer and exit once compared
+    bool fast;
 } runner;
 
+static struct {
+    int frame;
+    bool commandsDone;
+    bool failed;
+    // Write the reference images instead of comparing against them
+    bool update;
+} golden;
+
+struct BenchScene {
+    const char *name;
+    // Called at the start of the scene's first frame
+    void (*start)(void);
+};
+
+static struct {
+    std::string output;
+    int frames;
+    size_t scene;
+    int frame;
+    std::vector<float> frameTimes;
+    std::vector<int> draws;
+    std::vector<int> switches;
+    std::vector<long> allocs;
+    long lastAllocations;
+    std::string results;
+} bench;
+
+static int floodFrame;
+
 static std::string name;
 static std::ifstream inital_savedata;
+// Written save data, checked or recorded in closeSaveFile
+static std::vector<Uint8> save_buffer;
 
 static Uint32 quit_timer(Uint32 interval, void *param) {
     (void)param;
@@ -39,6 +138,37 @@ static void quit_in_a_bit(void) {
     SDL_AddTimer(AUTOQUIT_PERIOD, quit_timer, NULL);
 }
 
+// Hard board before the first click
+static Save::Data flood_board(void) {
+    using namespace Flood;
+    Save::Data data;
+    data.rows = ROWS;
+    data.cols = COLS;
+    data.state = GameState::READY;
+    data.tiles.assign(ROWS * COLS, TileSaveData::DEFAULT);
+    return data;
+}
+
+static void flood_check(void) {
+    using namespace Flood;
+    Save::Data expected = flood_board();
+    expected.tiles[ROW * COLS + COL] |= TileSaveData::FLAGGED;
+
+    Save::Data saved;
+    const char *error = Save::decode(save_buffer.data(), save_buffer.size(), saved);
+    if (error) {
+        printf("flood FAILED, invalid save (%s)\n", error);
+        exit(1);
+    }
+    if (saved.tiles != expected.tiles) {
+        printf("flood FAILED, the board doesn't show %d flag toggles\n", TOGGLES);
+        exit(1);
+    }
+    printf("flood SUCCEEDED\n");
+    state = FINISHED;
+    quit();
+}
+
 void closeSaveFile(void) {
     if (inital_savedata.is_open()) {
         inital_savedata.close();
@@ -47,6 +177,7 @@ void closeSaveFile(void) {
 
     switch (state) {
     case RECORDING:
+        recorder.expected.write((const char *)save_buffer.data(), save_buffer.size());
         recorder.file.close();
         recorder.expected.close();
         state = FINISHED;
@@ -54,6 +185,13 @@ void closeSaveFile(void) {
         return;
 
     case RUNNING:
+        for (Uint8 value : save_buffer) {
+            uint8_t expected = runner.expected.get();
+            if (runner.completed && value != expected) {
+                runner.completed = false;
+                printf("expected %c (%d) but got %c (%d)\n", expected, expected, value, value);
+            }
+        }
         if (runner.completed) {
             printf("%s SUCCEEDED\n", name.c_str());
         } else {
@@ -62,9 +200,20 @@ void closeSaveFile(void) {
         }
         runner.expected.close();
         state = FINISHED;
+        if (runner.fast) {
+            if (!runner.completed) exit(1);
+            quit();
+            return;
+        }
         quit_in_a_bit();
         return;
 
+    case FLOOD:
+        flood_check();
+        return;
+
+    case GOLDEN:
+    case BENCH:
     case FINISHED:
         // do nothing
         return;
@@ -88,7 +237,9 @@ static int onEvent(void *userdata, SDL_Event *event) {
 }
 
 bool openSaveReader(void) {
-    assert(state == RUNNING || state == RECORDING);
+    // Bench and flood boards are restored once the game is running
+    if (state == BENCH || state == FLOOD) return false;
+    assert(state == RUNNING || state == RECORDING || state == GOLDEN);
     std::string file_name = name + ".initial";
     inital_savedata.open(file_name);
     if (!inital_savedata.is_open()) {
@@ -98,15 +249,25 @@ bool openSaveReader(void) {
     return true;
 }
 Uint8 readByte(void) {
-    assert(state == RUNNING || state == RECORDING);
+    assert(state == RUNNING || state == RECORDING || state == GOLDEN);
     return inital_savedata.get();
 }
+size_t readBytes(Uint8 *data, size_t size) {
+    assert(state == RUNNING || state == RECORDING || state == GOLDEN);
+    inital_savedata.read((char *)data, size);
+    return inital_savedata.gcount();
+}
 bool openSaveWriter(void) {
     std::string save_file_name = name + ".expected";
+    save_buffer.clear();
 
     switch (state) {
+    case GOLDEN:
+    case BENCH:
     case FINISHED:
         return false;
+    case FLOOD:
+        return true;
     case RECORDING:
         recorder.expected.open(save_file_name);
         if (!recorder.expected.is_open()) {
@@ -126,28 +287,28 @@ bool openSaveWriter(void) {
 }
 
 int writeByte(Uint8 value) {
+    return writeBytes(&value, 1);
+}
+
+size_t writeBytes(const Uint8 *data, size_t size) {
     switch (state) {
     case RECORDING:
-        recorder.expected << value;
-        return 1;
-
-    case RUNNING: {
-        uint8_t expected = runner.expected.get();
-        if (runner.completed && value != expected) {
-            runner.completed = false;
-            printf("expected %c (%d) but got %c (%d)\n", expected, expected, value, value);
-        }
-        return 1;
-    }
+    case RUNNING:
+    case FLOOD:
+        save_buffer.insert(save_buffer.end(), data, data + size);
+        return size;
+
+    case GOLDEN:
+    case BENCH:
     case FINISHED:
         assert(false && "writing data while finished");
         return 0;
     }
+    return 0;
 }
 
-Uint32 process_next_command(Uint32 interval, void *param) {
-    (void)param;
-    assert(state == RUNNING);
+// Feed the next recorded command to the game, false once there are none left
+static bool apply_next_command(void) {
     std::string cmd;
     runner.sim_input >> cmd;
     if (cmd == "CLICK") {
@@ -155,36 +316,362 @@ Uint32 process_next_command(Uint32 interval, void *param) {
         runner.sim_input >> x;
         runner.sim_input >> y;
         onClick(x, y);
-        return interval;
+        return true;
     } else if (cmd == "ALTCLICK") {
         int x, y;
         runner.sim_input >> x;
         runner.sim_input >> y;
         onAltClick(x, y);
-        return interval;
+        return true;
     } else if (cmd == "") {
-        runner.completed = true;
-        save();
-        return 0;
+        return false;
     } else {
         fprintf(stderr, "input sim unexpected \"%s\"\n", cmd.c_str());
         exit(1);
-        return 0;
+        return false;
+    }
+}
+
+Uint32 process_next_command(Uint32 interval, void *param) {
+    (void)param;
+    assert(state == RUNNING);
+    if (apply_next_command()) {
+        return interval;
+    }
+    runner.completed = true;
+    save();
+    return 0;
+}
+
+// Compare against the reference image, or write it in update mode
+static bool compare_golden(SDL_Surface *actual, const std::string& ref_name) {
+    using namespace Golden;
+
+    if (golden.update) {
+        if (IMG_SavePNG(actual, ref_name.c_str()) < 0) {
+            printf("Failed to write %s (%s)\n", ref_name.c_str(), IMG_GetError());
+            return false;
+        }
+        printf("Wrote reference image %s\n", ref_name.c_str());
+        return true;
+    }
+
+    SDL_Surface *loaded = IMG_Load(ref_name.c_str());
+    if (loaded == nullptr) {
+        printf("Missing reference image %s, `update %s` writes it\n", ref_name.c_str(), name.c_str());
+        return false;
+    }
+    SDL_Surface *expected = SDL_ConvertSurfaceFormat(loaded, actual->format->format, 0);
+    SDL_FreeSurface(loaded);
+    if (expected == nullptr) {
+        printf("Failed to convert %s (%s)\n", ref_name.c_str(), SDL_GetError());
+        return false;
+    }
+
+    bool matches = false;
+    if (expected->w != actual->w || expected->h != actual->h) {
+        printf("%s is %dx%d but rendered %dx%d\n", ref_name.c_str(), expected->w, expected->h, actual->w, actual->h);
+    } else {
+        long changed = 0;
+        for (int y = 0; y < actual->h; ++y) {
+            const Uint8 *a = (const Uint8 *)actual->pixels + y * actual->pitch;
+            const Uint8 *e = (const Uint8 *)expected->pixels + y * expected->pitch;
+            for (int i = 0; i < actual->w * 4; i += 4) {
+                for (int c = 0; c < 4; ++c) {
+                    if (abs(a[i + c] - e[i + c]) > CHANNEL_TOLERANCE) {
+                        changed += 1;
+                        break;
+                    }
+                }
+            }
+        }
+        const double fraction = changed / double(actual->w * actual->h);
+        matches = fraction <= MAX_CHANGED;
+        if (!matches) {
+            printf("%s: %ld pixels (%.2f%%) differ\n", ref_name.c_str(), changed, fraction * 100.0);
+        }
+    }
+    SDL_FreeSurface(expected);
+
+    if (!matches) {
+        std::string actual_name = ref_name.substr(0, ref_name.size() - 4) + ".actual.png";
+        IMG_SavePNG(actual, actual_name.c_str());
+        printf("Wrote %s\n", actual_name.c_str());
+    }
+    return matches;
+}
+
+static void golden_update(void) {
+    using namespace Golden;
+    using namespace Replay;
+
+    golden.frame += 1;
+
+    if (!golden.commandsDone) {
+        if (golden.frame % COMMAND_FRAMES == 0 && !apply_next_command()) {
+            golden.commandsDone = true;
+            golden.frame = 0;
+        }
+        return;
     }
+
+    for (int capture : CAPTURE_FRAMES) {
+        if (golden.frame != capture) continue;
+
+        SDL_Surface *surface = captureBoard();
+        if (surface == nullptr || !compare_golden(surface, name + "." + std::to_string(capture) + ".png")) {
+            golden.failed = true;
+        }
+        SDL_FreeSurface(surface);
+    }
+
+    const int last = sizeof(CAPTURE_FRAMES) / sizeof(CAPTURE_FRAMES[0]) - 1;
+    if (golden.frame >= CAPTURE_FRAMES[last]) {
+        state = FINISHED;
+        if (golden.failed) {
+            printf("%s golden FAILED\n", name.c_str());
+            exit(1);
+        }
+        printf("%s golden SUCCEEDED\n", name.c_str());
+        quit();
+    }
+}
+
+// Hard board right after the first click
+static Save::Data hard_board(void) {
+    using namespace RenderBench;
+    Minefield field(SEED);
+    field.rows = HARD_ROWS;
+    field.cols = HARD_COLS;
+    field.reset();
+    std::vector<Minefield::Flip> flipped;
+    field.click(HARD_ROWS / 2, HARD_COLS / 2, flipped);
+    return field.snapshot();
+}
+
+static void click_tile(int row, int col) {
+    SDL_Point center = tileCenter(row, col);
+    onClick(center.x, center.y);
+}
+
+static void bench_idle(void) {
+    restoreGame(hard_board());
+}
+
+static void bench_cascade(void) {
+    using namespace RenderBench;
+    Save::Data data;
+    data.rows = CASCADE_ROWS;
+    data.cols = CASCADE_COLS;
+    data.state = GameState::STARTED;
+    data.seed = SEED;
+    data.tiles.assign(CASCADE_ROWS * CASCADE_COLS, TileSaveData::HIDDEN);
+    for (int c = 0; c < CASCADE_COLS; c += CASCADE_MINE_SPACING) {
+        data.tiles[(CASCADE_ROWS - 1) * CASCADE_COLS + c] |= TileSaveData::MINE;
+    }
+    restoreGame(data);
+    click_tile(0, 0);
+}
+
+static void bench_loss(void) {
+    Save::Data data = hard_board();
+    restoreGame(data);
+    for (size_t i = 0; i < data.tiles.size(); ++i) {
+        if (data.tiles[i] & TileSaveData::MINE) {
+            click_tile(i / data.cols, i % data.cols);
+            return;
+        }
+    }
+}
+
+static void bench_win(void) {
+    // Reveal every safe tile but one, then click that one
+    Save::Data data = hard_board();
+    size_t last = 0;
+    for (size_t i = 0; i < data.tiles.size(); ++i) {
+        if (data.tiles[i] & TileSaveData::MINE) continue;
+        data.tiles[i] &= ~TileSaveData::HIDDEN;
+        last = i;
+    }
+    data.tiles[last] |= TileSaveData::HIDDEN;
+    restoreGame(data);
+    click_tile(last / data.cols, last % data.cols);
+}
+
+static const BenchScene BENCH_SCENES[] = {
+    { "idle",     bench_idle },
+    { "cascade",  bench_cascade },
+    { "loss",     bench_loss },
+    { "win",      bench_win },
+};
+
+template <typename T>
+static double bench_percentile(std::vector<T> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[size_t(p * (values.size() - 1))];
+}
+
+template <typename T>
+static double bench_mean(const std::vector<T>& values) {
+    double total = 0;
+    for (T value : values) total += value;
+    return total / values.size();
+}
+
+static void bench_finish_scene(void) {
+    const char *scene = BENCH_SCENES[bench.scene].name;
+    const double p50 = bench_percentile(bench.frameTimes, 0.5);
+    const double p90 = bench_percentile(bench.frameTimes, 0.9);
+    const double p99 = bench_percentile(bench.frameTimes, 0.99);
+    const double max = bench_percentile(bench.frameTimes, 1.0);
+    const double draws = bench_mean(bench.draws);
+    const double switches = bench_mean(bench.switches);
+    const double allocs = bench_mean(bench.allocs);
+    printf("%-8s frame ms p50 %.2f p90 %.2f p99 %.2f max %.2f  draws %.1f  texture switches %.1f  allocs %.1f\n",
+           scene, p50, p90, p99, max, draws, switches, allocs);
+
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "%s    {\"name\": \"%s\", \"frames\": %zu, \"frame_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+             "\"draw_calls\": %.1f, \"max_draw_calls\": %d, \"texture_switches\": %.1f, \"max_texture_switches\": %d, "
+             "\"allocations\": %.2f, \"max_allocations\": %ld}",
+             bench.results.empty() ? "" : ",\n", scene, bench.frameTimes.size(), p50, p90, p99, max,
+             draws, *std::max_element(bench.draws.begin(), bench.draws.end()),
+             switches, *std::max_element(bench.switches.begin(), bench.switches.end()),
+             allocs, *std::max_element(bench.allocs.begin(), bench.allocs.end()));
+    bench.results += buf;
+
+    bench.frameTimes.clear();
+    bench.draws.clear();
+    bench.switches.clear();
+    bench.allocs.clear();
+}
+
+static void bench_update(void) {
+    const size_t sceneCount = sizeof(BENCH_SCENES) / sizeof(BENCH_SCENES[0]);
+
+    const long allocated = allocations - bench.lastAllocations;
+    bench.lastAllocations = allocations;
+
+    if (bench.frame == 0) {
+        BENCH_SCENES[bench.scene].start();
+    } else if (bench.frame > 1) {
+        // The profiler has the stats of the previous frame,
+        // the first frame of a scene is skipped since it set the scene up
+        bench.frameTimes.push_back(Profiler.lastFrameTime());
+        bench.draws.push_back(Profiler.lastDraws());
+        bench.switches.push_back(Profiler.lastTextureSwitches());
+        bench.allocs.push_back(allocated);
+    }
+
+    bench.frame += 1;
+    if (bench.frame <= bench.frames + 1) return;
+
+    bench_finish_scene();
+    bench.frame = 0;
+    bench.scene += 1;
+    if (bench.scene < sceneCount) return;
+
+    FILE *out = fopen(bench.output.c_str(), "w");
+    if (!out) {
+        fprintf(stderr, "Failed to open %s (%s)\n", bench.output.c_str(), strerror(errno));
+        exit(1);
+    }
+    fprintf(out, "{\n  \"renderer\": \"software\",\n  \"scenes\": [\n%s\n  ]\n}\n", bench.results.c_str());
+    fclose(out);
+    printf("Wrote %s\n", bench.output.c_str());
+
+    state = FINISHED;
+    quit();
+}
+
+static void flood_update(void) {
+    using namespace Flood;
+    floodFrame += 1;
+    if (floodFrame == 1) {
+        restoreGame(flood_board());
+    }
+    else if (floodFrame == SETTLE_FRAMES) {
+        const SDL_Point center = tileCenter(ROW, COL);
+        for (int i = 0; i < TOGGLES; ++i) {
+            onAltClick(center.x, center.y);
+        }
+        // On the main thread this plays every queued toggle, then saves
+        save();
+    }
+}
+
+void frontend_update(void) {
+    // SDL isn't initialized yet in frontend_init
+    static bool started = false;
+    if (!started) {
+        started = true;
+        SDL_AddEventWatch(onEvent, NULL);
+        if (state == RUNNING && !runner.fast) {
+            SDL_AddTimer(INTERVAL, process_next_command, NULL);
+        }
+    }
+
+    if (state == RUNNING && runner.fast) {
+        // The game state doesn't depend on animation time, so every command
+        // is applied back to back. Returns 0 once the game was saved
+        while (process_next_command(INTERVAL, NULL)) {}
+    }
+    else if (state == GOLDEN) {
+        golden_update();
+    }
+    else if (state == BENCH) {
+        bench_update();
+    }
+    else if (state == FLOOD) {
+        flood_update();
+    }
+}
+
+void frontend_quit(void) {
 }
 
 static void usage(void) {
-    printf("Usage: run|record <file>\n");
+    printf("Usage: run|fast|record|golden|update <file>\n"
+           "       bench <output.json> [frames per scene]\n"
+           "       flood\n");
     exit(1);
 }
 
 static void run() {
+    // Run on servers without a display, MINEHEADLESS=0 shows the window
+    Sim.headless = true;
     runner.sim_input.open(name);
     if (!runner.sim_input.is_open()) {
         fprintf(stderr, "Failed to open %s (%s)\n", name.c_str(), strerror(errno));
         exit(1);
     }
-    SDL_AddTimer(INTERVAL, process_next_command, NULL);
+}
+
+// Replay every command in the first frame on virtual time, without
+// rendering, exiting with status 1 if the save doesn't match
+static void run_fast() {
+    run();
+    runner.fast = true;
+    Sim.noRender = true;
+    Clock.setVirtual(Replay::FRAME_TICKS);
+}
+
+// Replay deterministically on virtual time with the software renderer
+// and compare frames against <file>.<frame>.png, or write them in update mode
+static void run_golden() {
+    run();
+    Clock.setVirtual(Replay::FRAME_TICKS);
+}
+
+// Render the benchmark scenes headless on virtual time, so every run
+// animates the same frames
+static void run_bench(char *frames) {
+    Sim.headless = true;
+    Clock.setVirtual(Replay::FRAME_TICKS);
+    bench.output = name;
+    bench.frames = frames ? atoi(frames) : RenderBench::DEFAULT_FRAMES;
+    if (bench.frames < 1) usage();
 }
 
 static void record() {
@@ -197,6 +684,12 @@ static void record() {
 }
 
 void frontend_init(char **arg) {
+    if (arg[0] && strcmp(arg[0], "flood") == 0) {
+        // On the wall clock, so moves pile up like they do in the game
+        state = FLOOD;
+        Sim.headless = true;
+        return;
+    }
     if (arg[0] == NULL || arg[1] == NULL) {
         usage();
     }
@@ -204,13 +697,25 @@ void frontend_init(char **arg) {
         state = RUNNING;
         name = arg[1];
         run();
+    } else if (strcmp(arg[0], "fast") == 0) {
+        state = RUNNING;
+        name = arg[1];
+        run_fast();
     } else if (strcmp(arg[0], "record") == 0) {
         state = RECORDING;
         name = arg[1];
         record();
+    } else if (strcmp(arg[0], "golden") == 0 || strcmp(arg[0], "update") == 0) {
+        state = GOLDEN;
+        name = arg[1];
+        golden.update = arg[0][0] == 'u';
+        run_golden();
+    } else if (strcmp(arg[0], "bench") == 0) {
+        state = BENCH;
+        name = arg[1];
+        run_bench(arg[2]);
     } else {
         usage();
     }
-    SDL_AddEventWatch(onEvent, NULL);
 }
 
@@ -11,7 +11,8 @@
 class Text {
 public:
     Text(TTF_Font * font, std::string string_={}, Color color = {0.f, 0.f, 0.f});
-    ~Text() = default;
+    Text(Text&&) = default;
+    Text& operator=(Text&&) = default;
 
     void render();
     void load();
@@ -1,5 +1,7 @@
 #include "texture.h"
 #include "text.h"
+#include "profiler.h"
+#include "assets.h"
 #include <SDL_rect.h>
 #include <SDL_image.h>
 #include <SDL_render.h>
@@ -20,9 +22,33 @@ Texture::~Texture() {
     free();
 }
 
+Texture::Texture(Texture&& other) noexcept
+    : width(other.width)
+    , height(other.height)
+    , imgWidth(other.imgWidth)
+    , imgHeight(other.imgHeight)
+    , texture(other.texture)
+{
+    other.texture = nullptr;
+}
+
+Texture& Texture::operator=(Texture&& other) noexcept {
+    if (this != &other) {
+        free();
+        width = other.width;
+        height = other.height;
+        imgWidth = other.imgWidth;
+        imgHeight = other.imgHeight;
+        texture = other.texture;
+        other.texture = nullptr;
+    }
+    return *this;
+}
+
 void Texture::render(int x, int y, SDL_Rect *clip, double angle, SDL_Point *center) const {
     const SDL_Rect dstrect = { x, y, width, height };
     SDL_RenderCopyEx(renderer, texture, clip, &dstrect, angle, center, SDL_FLIP_NONE);
+    Profiler.countDraw(texture);
 }
 
 void Texture::renderPart(int x, int y, const SDL_Rect *rect, bool stretchSource) const {
@@ -36,23 +62,27 @@ void Texture::renderPart(int x, int y, const SDL_Rect *rect, bool stretchSource)
     const SDL_Rect dstrect = { x + rect->x, y + rect->y, rect->w, rect->h };
 
     SDL_RenderCopy(renderer, texture, stretchSource ? NULL : &srcrect, &dstrect);
+    Profiler.countDraw(texture);
 }
 
 void Texture::renderWithHeight(int x, int y, int h) const {
     int scale = h / imgHeight;
     const SDL_Rect dstrect = { x, y, scale * imgWidth, scale * imgHeight };
     SDL_RenderCopy(renderer, texture, NULL, &dstrect);
+    Profiler.countDraw(texture);
 }
 
 void Texture::renderWithWidth(int x, int y, int w) const {
     int scale = w / imgWidth;
     const SDL_Rect dstrect = { x, y, scale * imgWidth, scale * imgHeight };
     SDL_RenderCopy(renderer, texture, NULL, &dstrect);
+    Profiler.countDraw(texture);
 }
 
 void Texture::renderWithScale(int x, int y, double scale) const {
     const SDL_Rect dstrect = { x, y, (int)(scale * imgWidth), (int)(scale * imgHeight) };
     SDL_RenderCopy(renderer, texture, NULL, &dstrect);
+    Profiler.countDraw(texture);
 }
 
 void Texture::free() {
@@ -65,24 +95,29 @@ void Texture::free() {
 }
 
 void Texture::loadFile(std::string& path) {
-    // Free any existing texture
-    free();
-
-    // Directly load image to texture
-    texture = IMG_LoadTexture(renderer, (Sim.runtimeBasePath + path).c_str());
-    if (texture == nullptr) {
+    SDL_Surface *surface = IMG_Load_RW(Assets::open(path), 1);
+    if (surface == nullptr) {
         fprintf(stderr, "Unable to create texture from image %s. SDL_image error: %s\n", path.c_str(), IMG_GetError());
         exit(1);
     }
+    loadSurface(surface);
+}
+
+void Texture::loadSurface(SDL_Surface *surface) {
+    // Free any existing texture
+    free();
 
-    // Get width and height of texture
-    if (SDL_QueryTexture(texture, nullptr, nullptr, &width, &height) < 0) {
-        fprintf(stderr, "Unable to query texture. SDL error: %s\n", SDL_GetError());
+    texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (texture == nullptr) {
+        fprintf(stderr, "Unable to create texture from image. SDL error: %s\n", SDL_GetError());
         exit(1);
     }
-
+    width = surface->w;
+    height = surface->h;
     imgWidth = width;
     imgHeight = height;
+
+    SDL_FreeSurface(surface);
 }
 
 void Texture::loadText(TTF_Font *font, const char *text, SDL_Color color) {
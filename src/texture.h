@@ -16,6 +16,12 @@ public:
     Texture();
     ~Texture();
 
+    // Owns the SDL texture, so it can be moved but not copied
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+    Texture(Texture&& other) noexcept;
+    Texture& operator=(Texture&& other) noexcept;
+
     void loadFile(std::string& path);
 
     // Overload to also set w and h
@@ -24,6 +30,10 @@ public:
         setSize(w, h);
     }
 
+    // Create the texture from a decoded image, takes ownership of the surface
+    // Must be called on the render thread
+    void loadSurface(SDL_Surface *surface);
+
     void loadText(TTF_Font *font, const char* text, SDL_Color color);
 
     void free();
@@ -1,5 +1,6 @@
 #include "tile.h"
 #include "game.h"
+#include "profiler.h"
 
 namespace Flag {
     namespace Rotation {
@@ -28,21 +29,23 @@ enum TileAnim {
 
 class FlagAnim : public Anim {
 public:
-    FlagAnim(const Texture *flagTex, SDL_Point pos, bool& isFlagged);
+    FlagAnim(const Texture *flagTex, SDL_Point pos, const Tile& tile);
 
     bool OnUpdate(double dt) override;
+    void OnRender(double t) override;
     void OnStart() override;
 
 private:
     const Texture* flag;
     SDL_Point pos;
-    bool& isFlagged;
+    const Tile& tile;
     double angle;
+    double prevAngle;
     SDL_Point rotPoint;
 };
 
-FlagAnim::FlagAnim(const Texture *flagTex, SDL_Point pos, bool&isFlagged)
-    : flag(flagTex), pos(pos), isFlagged(isFlagged)
+FlagAnim::FlagAnim(const Texture *flagTex, SDL_Point pos, const Tile& tile)
+    : flag(flagTex), pos(pos), tile(tile)
 {
     using namespace Flag;
     rotPoint.x = (int)(Rotation::POINT_X * flag->getWidth());
@@ -51,7 +54,8 @@ FlagAnim::FlagAnim(const Texture *flagTex, SDL_Point pos, bool&isFlagged)
 
 void FlagAnim::OnStart() {
     using namespace Flag;
-    angle = isFlagged ? Rotation::START_DEGREES : 0.0;
+    angle = tile.isFlagged() ? Rotation::START_DEGREES : 0.0;
+    prevAngle = angle;
 }
 
 
@@ -61,13 +65,17 @@ bool FlagAnim::OnUpdate(double dt) {
     if (angle < 0.0 || angle > Rotation::START_DEGREES) {
         return false;
     }
-    if (isFlagged) angle -= Rotation::DELTA_DEGREES * dt;
+    prevAngle = angle;
+    if (tile.isFlagged()) angle -= Rotation::DELTA_DEGREES * dt;
     else angle += Rotation::DELTA_DEGREES * dt;
-    
-    flag->render(pos.x, pos.y, nullptr, angle, &rotPoint);
+
     return true;
 }
 
+void FlagAnim::OnRender(double t) {
+    flag->render(pos.x, pos.y, nullptr, lerp(prevAngle, angle, t), &rotPoint);
+}
+
 class UncoverAnim : public Anim {
 public:
     UncoverAnim(const Texture *hidden, SDL_Point pos, std::mt19937& rng);
@@ -76,6 +84,7 @@ public:
 
     void OnStart() override;
     bool OnUpdate(double dt) override;
+    void OnRender(double t) override;
 
 private:
     const Texture *hidden;
@@ -84,6 +93,8 @@ private:
 
     double widthPercent;
     double heightPercent;
+    double prevWidthPercent;
+    double prevHeightPercent;
     double deltaWidth;
     double deltaHeight;
     bool inverseX;
@@ -98,6 +109,8 @@ UncoverAnim::UncoverAnim(const Texture *hidden, SDL_Point pos, std::mt19937& rng
     , rng(rng)
     , widthPercent(1.0)
     , heightPercent(1.0)
+    , prevWidthPercent(1.0)
+    , prevHeightPercent(1.0)
     , deltaWidth(0.0)
     , deltaHeight(0.0)
     , inverseX(false)
@@ -118,20 +131,25 @@ void UncoverAnim::OnStart() {
 }
 
 bool UncoverAnim::OnUpdate(double dt) {
+    prevWidthPercent = widthPercent;
+    prevHeightPercent = heightPercent;
     widthPercent -= deltaWidth * dt;
     heightPercent -= deltaHeight * dt;
 
-    if (widthPercent < 0 || heightPercent < 0) return false;
+    return widthPercent >= 0 && heightPercent >= 0;
+}
+
+void UncoverAnim::OnRender(double t) {
+    const double width = lerp(prevWidthPercent, widthPercent, t);
+    const double height = lerp(prevHeightPercent, heightPercent, t);
 
     SDL_Rect rect;
-    rect.x = inverseX ? int(hidden->getWidth() * (1 - widthPercent)) : 0;
-    rect.y = inverseY ? int(hidden->getHeight() * (1 - heightPercent)) : 0;
-    rect.w = int(hidden->getWidth() * widthPercent);
-    rect.h = int(hidden->getHeight() * heightPercent);
+    rect.x = inverseX ? int(hidden->getWidth() * (1 - width)) : 0;
+    rect.y = inverseY ? int(hidden->getHeight() * (1 - height)) : 0;
+    rect.w = int(hidden->getWidth() * width);
+    rect.h = int(hidden->getHeight() * height);
 
     hidden->renderPart(pos.x, pos.y, &rect, true);
-
-    return true;
 }
 
 class WinTileAnim : public Anim {
@@ -141,11 +159,13 @@ public:
 
     void OnStart() override;
     bool OnUpdate(double dt) override;
+    void OnRender(double t) override;
 
 private:
     SDL_Point pos;
     int size;
     Color color {0x008000};
+    percent prevAlpha = color.a;
     SDL_Rect fillrect { pos.x, pos.y, size, size };
 };
 
@@ -156,20 +176,24 @@ void WinTileAnim::OnStart() {
 }
 
 bool WinTileAnim::OnUpdate(double dt) {
-    color.draw();
-    SDL_RenderFillRect(renderer, &fillrect);
-
+    prevAlpha = color.a;
     color.a += dt * WinTile::DELTA_ALPHA;
     return color.a > 0.0;
 }
 
+void WinTileAnim::OnRender(double t) {
+    Color drawColor = color;
+    drawColor.a = lerp(prevAlpha, color.a, t);
+    drawColor.draw();
+    SDL_RenderFillRect(renderer, &fillrect);
+    Profiler.countDraw();
+}
+
 Tile::Tile(Texture *tex) : Button(tex) {
-    setHidden(false);
-    setFlagged(false);
-    setMine(false);
     row = 0;
     col = 0;
-    isRed = false;
+    game = nullptr;
+    field = nullptr;
 }
 
 // WARNING: copy constructor and operator= don't actually copy fields rn
@@ -182,158 +206,59 @@ void Tile::operator=(Tile other) {
     (void)other;
 }
 
-Uint8 Tile::save() {
-    using namespace TileSaveData;
-    Uint8 data = 0;
-    if (isHidden())   data |= HIDDEN;
-    if (isMine())     data |= MINE;
-    if (isFlagged())  data |= FLAGGED;
-    if (isRed)        data |= RED;
-    if (removed)      data |= REMOVED;
-    return data;
+void Tile::setGame(Game *parent) {
+    game = parent;
+    field = parent;
 }
 
-void Tile::load(Uint8 data) {
-    using namespace TileSaveData;
-    setMine     (data & MINE);
-    setHidden   (data & HIDDEN);
-    setFlagged  (data & FLAGGED);
-    isRed =      data & RED;
-    removed =    data & REMOVED;
-}
-
-int Tile::countTouchingMines() const {
-    int nearbyMines = 0;
-    foreach_touching_tile([&](Tile& tile) -> void {
-        if (tile.isMine()) {
-            nearbyMines += 1;
-        }
-    });
-
-    return nearbyMines;
-}
-
-
 void Tile::playFlagAnim() {
     if (animState.isAnimActive(TileAnim::FLAG_ANIM)) return;
 
-    auto flagAnim = new FlagAnim(&game->tileOverlays[TileOverlay::FLAG], {x, y}, flagged);
+    auto flagAnim = new FlagAnim(&game->tileOverlays[TileOverlay::FLAG], {x, y}, *this);
     animState.play(TileAnim::FLAG_ANIM, flagAnim);
 }
 
-void Tile::flag() {
-    setFlagged(true);
-    playFlagAnim();
-    game->updateFlagCount();
-}
-
-void Tile::unflag() {
-    setFlagged(false);
-    playFlagAnim();
-    game->updateFlagCount();
-}
-
 void Tile::mouseEnter() {
     if (animState.isAnimActive(TileAnim::UNCOVER) && !animState.started) {
         // remove delay on uncover animation when user hovers over
-        animState.startTime = SDL_GetTicks();
+        animState.startTime = Clock.ticks();
     }
 }
 
 void Tile::reset() {
     animState.kill();
-    setMine(false);
-    setFlagged(false);
-    setHidden(true);
-    isRed = false;
-    removed = false;
-}
-
-void Tile::red() {
-    isRed = true;
 }
 
-void Tile::dissapear() {
+void Tile::playWinAnim() {
     animState.play(-1, new WinTileAnim({x, y}, SIZE));
-    removed = true;
 }
 
 constexpr int TILE_BASE_SIZE = 32;
 int Tile::SIZE = TILE_BASE_SIZE;
 
-void Tile::flip(bool recurse, Uint32 delay) {
-    setHidden(false);
+void Tile::playRevealAnim(Uint32 delay) {
     if (isMine()) {
         auto anim = new MineRevealAnim({x,y}, SIZE);
         animState.play(TileAnim::REVEALMINE, anim, delay);
     }
     else {
-        int neighboringMines = countTouchingMines();
-
-        playUncoverAnim(delay);
-
-        if (recurse && neighboringMines == 0) {
-            // Recursively reveal surrounding tiles
-            foreach_touching_tile([&recurse, &delay](Tile& tile) {
-                if (tile.isHidden()) {
-                    tile.flip(recurse, delay += 100);
-                }
-            });
-        }
-    }
-}
-
-void Tile::playUncoverAnim(Uint32 delay) {
-    auto uncoverAnim = new UncoverAnim(&game->tileBackgrounds[TileBG::HIDDEN], {x, y}, game->rng);
-
-    animState.play(TileAnim::UNCOVER, uncoverAnim, delay);
-
-}
-
-void Tile::foreach_touching_tile(std::function<void(Tile&)> callback, bool diagonals) const {
-    // Rather verbose of me
-
-    const int left = col - 1;
-    const int right = col + 1;
-    const int below = row + 1;
-    const int above = row - 1;
-
-    const bool spaceLeft = left >= 0;
-    const bool spaceRight = right < game->cols;
-    const bool spaceAbove = above >= 0;
-    const bool spaceBelow = below < game->rows;
-
-    auto& board = game->board;
-
-    if (spaceLeft) callback(board[row][left]);
-    if (spaceRight) callback(board[row][right]);
-    if (spaceAbove) callback(board[above][col]);
-    if (spaceBelow) callback(board[below][col]);
-
-    if (diagonals) {
-        if (spaceLeft && spaceAbove) callback(board[above][left]);
-        if (spaceRight && spaceAbove) callback(board[above][right]);
-        if (spaceLeft && spaceBelow) callback(board[below][left]);
-        if (spaceRight && spaceBelow) callback(board[below][right]);
+        auto uncoverAnim = new UncoverAnim(&game->tileBackgrounds[TileBG::HIDDEN], {x, y}, game->effects);
+        animState.play(TileAnim::UNCOVER, uncoverAnim, delay);
     }
 }
 
 Texture *Tile::getBackground(bool isSelected) {
     using namespace TileBG;
-    if (removed) return nullptr;
+    if (!exists()) return nullptr;
     if (isSelected && isClickable()) return &game->tileBackgrounds[HIGHLIGHT];
-    if (isRed) return &game->tileBackgrounds[RED_SQUARE];
+    if (isRed()) return &game->tileBackgrounds[RED_SQUARE];
     if (isHidden() || animState.isAnimPending()) return &game->tileBackgrounds[HIDDEN];
     return &game->tileBackgrounds[BLANK_SQUARE];
 }
 
-bool Tile::isClickable() {
-    return isHidden() && isUnflagged() && !(game->state & GameState::OVER);
-}
-
 Texture *Tile::getOverlay(void) {
     using namespace TileOverlay;
-    if (removed) return nullptr;
+    if (!exists()) return nullptr;
     if (isHidden() && isFlagged() &&
         !animState.isAnimActive(TileAnim::FLAG_ANIM)) return &game->tileOverlays[FLAG];
     size_t neighbours = countTouchingMines();
@@ -4,6 +4,7 @@
 
 #include "button.h"
 #include "anim.h"
+#include "minefield.h"
 
 #define NUMBER_TILES_COUNT 8
 
@@ -28,18 +29,6 @@ namespace TileOverlay {
     };
 }
 
-namespace TileSaveData {
-    enum {
-        HIDDEN  = 1,
-        MINE    = 2,
-        FLAGGED = 4,
-        RED     = 8,
-        REMOVED = 16,
-
-        DEFAULT = HIDDEN,
-    };
-}
-
 class Game;
 
 class Tile : public Button {
@@ -57,40 +46,27 @@ public:
     void operator=(Tile other);
 
 
-    [[nodiscard]] bool isMine() const { return mine; }
-    [[nodiscard]] bool isSafe() const { return !mine; }
-
-    [[nodiscard]] bool isHidden() const { return hidden; }
-    [[nodiscard]] bool isRevealed() const { return !hidden; }
+    // The cell's state lives in the Minefield, a Tile only animates it
+    [[nodiscard]] bool isMine() const { return field->isMine(row, col); }
+    [[nodiscard]] bool isSafe() const { return !isMine(); }
 
-    [[nodiscard]] bool isFlagged() const { return flagged; }
-    [[nodiscard]] bool isUnflagged() const { return !flagged; }
-    [[nodiscard]] bool exists() const { return !removed; }
+    [[nodiscard]] bool isHidden() const { return field->isHidden(row, col); }
+    [[nodiscard]] bool isRevealed() const { return !isHidden(); }
 
-    void setMine(bool f) { mine = f; }
-    void setFlagged(bool f) { flagged = f; }
-    void setHidden(bool f) { hidden = f; }
+    [[nodiscard]] bool isFlagged() const { return field->isFlagged(row, col); }
+    [[nodiscard]] bool isUnflagged() const { return !isFlagged(); }
+    [[nodiscard]] bool isRed() const { return field->isRed(row, col); }
+    [[nodiscard]] bool exists() const { return !field->isRemoved(row, col); }
+    [[nodiscard]] bool isClickable() const { return field->isClickable(row, col); }
+    [[nodiscard]] int countTouchingMines() const { return field->countTouchingMines(row, col); }
 
-    void flag();
-    void unflag();
-    void flip(bool flipNeighbors = true, Uint32 delay = 0);
+    void playFlagAnim();
+    void playRevealAnim(Uint32 delay);
+    void playWinAnim();
     void reset();
-    void red();
     void mouseEnter() override;
-    void dissapear();
-    bool isClickable();
-
-    bool isRed;
-    bool removed;
-
-    void setGame(Game *parent) { game = parent; }
-
-    void foreach_touching_tile(std::function<void(Tile&)> callback, bool diagonals = true) const;
-    int countTouchingMines() const;
-
-    Uint8 save();
-    void load(Uint8 data);
 
+    void setGame(Game *parent);
 
     int row;
     int col;
@@ -99,12 +75,8 @@ public:
     static int SIZE;
     Game *game;
 private:
-    bool mine;
-    bool hidden;
-    bool flagged;
+    const Minefield *field;
 
-    void playFlagAnim();
-    void playUncoverAnim(Uint32 delay);
     Texture *getBackground(bool isSelected);
     Texture *getOverlay(void);
 
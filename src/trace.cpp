@@ -0,0 +1,114 @@
+#include "trace.h"
+#include <SDL_timer.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+    struct Event {
+        const char *name;
+        Uint64 start;
+        // 0 for instant events
+        Uint64 end;
+        Sint64 value;
+    };
+
+    // Written only by its own thread, so recording never takes a lock.
+    // Once full the oldest events are overwritten, which takes minutes at
+    // the handful of spans a frame records.
+    struct ThreadBuffer {
+        static constexpr Uint64 CAPACITY = 1 << 18;
+        Event events[CAPACITY];
+        std::atomic<Uint64> head { 0 };
+        int tid;
+
+        void push(const Event& e) {
+            const Uint64 index = head.load(std::memory_order_relaxed);
+            events[index % CAPACITY] = e;
+            head.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    constexpr int MAX_THREADS = 32;
+    std::atomic<ThreadBuffer*> buffers[MAX_THREADS];
+    std::atomic<int> bufferCount { 0 };
+
+    std::string path;
+    Uint64 origin;
+
+    ThreadBuffer *threadBuffer() {
+        thread_local ThreadBuffer *buffer = nullptr;
+        if (!buffer) {
+            const int slot = bufferCount.fetch_add(1);
+            if (slot >= MAX_THREADS) return nullptr;
+            buffer = new ThreadBuffer;
+            buffer->tid = slot + 1;
+            buffers[slot].store(buffer, std::memory_order_release);
+        }
+        return buffer;
+    }
+}
+
+std::atomic<bool> Trace::enabled { false };
+
+void Trace::init() {
+    const char *env = getenv("MINETRACE");
+    if (!env || !*env) return;
+
+    path = env;
+    origin = SDL_GetPerformanceCounter();
+    enabled = true;
+}
+
+Uint64 Trace::now() {
+    return SDL_GetPerformanceCounter();
+}
+
+void Trace::span(const char *name, Uint64 start, Uint64 end) {
+    if (auto buffer = threadBuffer()) buffer->push({ name, start, end, 0 });
+}
+
+void Trace::instant(const char *name, Sint64 value) {
+    if (auto buffer = threadBuffer()) buffer->push({ name, now(), 0, value });
+}
+
+void Trace::flush() {
+    if (!enabled.exchange(false)) return;
+
+    FILE *out = fopen(path.c_str(), "w");
+    if (!out) {
+        printf("Failed to write trace to %s\n", path.c_str());
+        return;
+    }
+
+    const double usPerCount = 1e6 / SDL_GetPerformanceFrequency();
+    auto micros = [&](Uint64 counter) { return (counter - origin) * usPerCount; };
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    const int count = std::min(bufferCount.load(), MAX_THREADS);
+    for (int i = 0; i < count; ++i) {
+        ThreadBuffer *buffer = buffers[i].load(std::memory_order_acquire);
+        if (!buffer) continue;
+
+        const Uint64 head = buffer->head.load(std::memory_order_acquire);
+        const Uint64 begin = head > ThreadBuffer::CAPACITY ? head - ThreadBuffer::CAPACITY : 0;
+        for (Uint64 j = begin; j < head; ++j) {
+            const Event& e = buffer->events[j % ThreadBuffer::CAPACITY];
+            if (e.end) {
+                fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        first ? "" : ",\n", e.name, buffer->tid, micros(e.start), (e.end - e.start) * usPerCount);
+            }
+            else {
+                fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                        first ? "" : ",\n", e.name, buffer->tid, micros(e.start), (long long)e.value);
+            }
+            first = false;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    printf("Wrote trace to %s\n", path.c_str());
+}
@@ -0,0 +1,44 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <SDL_stdinc.h>
+#include <atomic>
+
+// Records timing spans into a Chrome trace_event JSON file that can be
+// opened in Perfetto or chrome://tracing.
+// Enabled by setting MINETRACE to the output path; otherwise every macro
+// costs a single branch.
+namespace Trace {
+    // Read from every thread that records
+    extern std::atomic<bool> enabled;
+
+    // Read MINETRACE and start recording
+    void init();
+    // Stop recording and write the file. Call once no other thread records
+    void flush();
+
+    Uint64 now();
+
+    // `name` must be a string literal, only the pointer is recorded
+    void span(const char *name, Uint64 start, Uint64 end);
+    void instant(const char *name, Sint64 value);
+
+    class Scope {
+    public:
+        explicit Scope(const char *name) : name(name), start(enabled.load(std::memory_order_relaxed) ? now() : 0) {}
+        ~Scope() {
+            if (start) span(name, start, now());
+        }
+
+    private:
+        const char *name;
+        Uint64 start;
+    };
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_INSTANT(name, value) do { if (Trace::enabled.load(std::memory_order_relaxed)) Trace::instant(name, value); } while (0)
+
+#endif
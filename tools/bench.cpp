@@ -0,0 +1,220 @@
+// Microbenchmarks of the game rules on every board size, written as JSON
+//
+//   minebench [output.json] [seconds per benchmark]
+//
+// Each benchmark times single operations with their setup excluded and
+// reports nanoseconds per operation. Build with CMAKE_BUILD_TYPE=Release
+// for numbers worth comparing.
+
+#include "minefield.h"
+#include "save.h"
+#include "sessions.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Bench {
+    constexpr double DEFAULT_SECONDS = 0.2;
+    constexpr int MIN_SAMPLES = 16;
+    // Cell size the game draws at, for the hit tests
+    constexpr int CELL_SIZE = 32;
+    // Hosted games for the session benchmarks, of which a quarter fit
+    // live for sessionRevive
+    constexpr int SESSIONS = 1024;
+
+    constexpr struct { const char *name; int rows; int cols; } BOARDS[] = {
+        { "easy",   8,  10 },
+        { "medium", 12, 15 },
+        { "hard",   15, 20 },
+        { "large",  MAX_FIELD_SIZE - 1, MAX_FIELD_SIZE - 1 },
+    };
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Results are summed in here so the work can't be optimized out
+static volatile long sink;
+
+struct Result {
+    std::string name;
+    std::string board;
+    int rows;
+    int cols;
+    size_t samples;
+    double mean;
+    double median;
+    double p90;
+    double min;
+};
+
+// Run setup() untimed and op() timed until `seconds` passed
+static Result measure(const char *name, const char *board, Minefield& field, double seconds,
+                      std::function<void()> setup, std::function<void()> op) {
+    std::vector<double> samples;
+    const auto end = Clock::now() + std::chrono::duration<double>(seconds);
+    while (samples.size() < Bench::MIN_SAMPLES || Clock::now() < end) {
+        setup();
+        const auto start = Clock::now();
+        op();
+        samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = name;
+    result.board = board;
+    result.rows = field.rows;
+    result.cols = field.cols;
+    result.samples = samples.size();
+    double total = 0;
+    for (double sample : samples) total += sample;
+    result.mean = total / samples.size();
+    result.median = samples[samples.size() / 2];
+    result.p90 = samples[samples.size() * 9 / 10];
+    result.min = samples.front();
+    return result;
+}
+
+static void newGame(Minefield& field, int rows, int cols, uint32_t seed) {
+    field.rows = rows;
+    field.cols = cols;
+    field.seed = seed;
+    field.rng.seed(seed);
+    field.reset();
+}
+
+static void benchBoard(const char *board, int rows, int cols, double seconds, std::vector<Result>& results) {
+    Minefield field(0);
+    std::vector<Minefield::Flip> flipped;
+    uint32_t seed = 0;
+    auto run = [&](const char *name, std::function<void()> setup, std::function<void()> op) {
+        results.push_back(measure(name, board, field, seconds, setup, op));
+        fprintf(stderr, "%-20s %-7s %9.0f ns\n", name, board, results.back().median);
+    };
+    auto fresh = [&]() { newGame(field, rows, cols, ++seed); };
+    auto started = [&]() {
+        fresh();
+        flipped.clear();
+        field.click(rows / 2, cols / 2, flipped);
+    };
+
+    run("generateMines", fresh, [&]() { field.generateMines(); });
+
+    // First click: flipTiles, generateMines and the recursive reveal
+    run("generateStartingArea", [&]() { fresh(); flipped.clear(); },
+        [&]() { field.click(rows / 2, cols / 2, flipped); });
+
+    // No mines at all, so one click recursively reveals the whole board
+    Save::Data empty;
+    empty.rows = rows;
+    empty.cols = cols;
+    empty.state = GameState::STARTED;
+    empty.tiles.assign(rows * cols, TileSaveData::HIDDEN);
+    run("flipOpening", [&]() { field.restore(empty); flipped.clear(); },
+        [&]() { field.click(0, 0, flipped); });
+
+    // The queries below scan a whole board per operation
+    run("countTouchingMines", started, [&]() {
+        long total = 0;
+        for (int r = 0; r < rows; ++r) for (int c = 0; c < cols; ++c) total += field.countTouchingMines(r, c);
+        sink = sink + total;
+    });
+
+    // Worst case, every safe cell is revealed
+    run("hasWon", [&]() { field.restore(empty); flipped.clear(); field.click(0, 0, flipped); },
+        [&]() { sink = sink + field.hasWon(); });
+
+    run("updateFlagCount", started, [&]() {
+        for (int r = 0; r < rows; ++r) for (int c = 0; c < cols; ++c) field.toggleFlag(r, c);
+        sink = sink + field.flagCount();
+    });
+
+    std::vector<uint8_t> bytes;
+    run("save", started, [&]() {
+        bytes = Save::encode(field.snapshot());
+        sink = sink + bytes.size();
+    });
+
+    run("load", [&]() { started(); bytes = Save::encode(field.snapshot()); }, [&]() {
+        Save::Data data;
+        if (Save::decode(bytes.data(), bytes.size(), data) == nullptr) field.restore(data);
+        sink = sink + field.flagCount();
+    });
+
+    run("getTileUnderMouse", started, [&]() {
+        long total = 0;
+        int r, c;
+        for (int y = 0; y < rows; ++y) for (int x = 0; x < cols; ++x) {
+            total += field.cellAt(x * Bench::CELL_SIZE + Bench::CELL_SIZE / 2, y * Bench::CELL_SIZE + Bench::CELL_SIZE / 2,
+                                  0, 0, Bench::CELL_SIZE, r, c);
+        }
+        sink = sink + total;
+    });
+
+    // Every operation flags a cell of the next of many started sessions,
+    // which loads it onto the scratch board
+    SessionManager::Reply reply;
+    auto host = [&](SessionManager& sessions, std::vector<SessionManager::Id>& ids) {
+        for (int i = 0; i < Bench::SESSIONS; ++i) {
+            sessions.dispatch({ SessionManager::Command::CREATE, 0, 0, 0, rows, cols, uint32_t(i) }, reply);
+            ids.push_back(reply.session);
+            sessions.dispatch({ SessionManager::Command::CLICK, reply.session, rows / 2, cols / 2, 0, 0, 0 }, reply);
+        }
+    };
+    size_t next = 0;
+    auto flagNext = [&](SessionManager& sessions, const std::vector<SessionManager::Id>& ids) {
+        const SessionManager::Id id = ids[next++ % ids.size()];
+        sessions.dispatch({ SessionManager::Command::FLAG, id, int(next % rows), 0, 0, 0, 0 }, reply);
+        sink = sink + reply.flags;
+    };
+
+    SessionManager allLive;
+    std::vector<SessionManager::Id> liveIds;
+    host(allLive, liveIds);
+    run("sessionFlag", []() {}, [&]() { flagNext(allLive, liveIds); });
+
+    // Most sessions are evicted, so a move revives one and now and then evicts a quarter
+    SessionManager quarterLive(Bench::SESSIONS / 4 * rows * cols);
+    std::vector<SessionManager::Id> evictedIds;
+    host(quarterLive, evictedIds);
+    run("sessionRevive", []() {}, [&]() { flagNext(quarterLive, evictedIds); });
+}
+
+static void writeJson(FILE *out, const std::vector<Result>& results) {
+    fprintf(out, "{\n  \"unit\": \"ns\",\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"board\": \"%s\", \"rows\": %d, \"cols\": %d, \"samples\": %zu, "
+                     "\"mean\": %.1f, \"median\": %.1f, \"p90\": %.1f, \"min\": %.1f}%s\n",
+                r.name.c_str(), r.board.c_str(), r.rows, r.cols, r.samples,
+                r.mean, r.median, r.p90, r.min, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : nullptr;
+    const double seconds = argc > 2 ? atof(argv[2]) : Bench::DEFAULT_SECONDS;
+
+    std::vector<Result> results;
+    for (auto& board : Bench::BOARDS) {
+        benchBoard(board.name, board.rows, board.cols, seconds, results);
+    }
+
+    FILE *out = path ? fopen(path, "w") : stdout;
+    if (!out) {
+        perror(path);
+        return 1;
+    }
+    writeJson(out, results);
+    if (path) {
+        fclose(out);
+        fprintf(stderr, "Wrote %s\n", path);
+    }
+    return 0;
+}
@@ -0,0 +1,360 @@
+// Serves games to automated players, without SDL, over a line protocol
+//
+//   minebot                  one client on stdin and stdout
+//   minebot --socket <path>  any number of clients on a Unix socket
+//
+// Every command is one line and gets exactly one reply line, in order:
+//
+//   new <rows> <cols> <seed>   ok <id>
+//   reveal <id> <row> <col>    ok <state> <count> <row>,<col>,<touching>...
+//   flag <id> <row> <col>      ok <state> <flags>
+//   status <id>                ok <state> <flags> <mines>
+//   board <id>                 ok <state> <rows> <cols> <row>...
+//   close <id>                 ok
+//
+// or with `err <reason>` if the command failed. <state> is ready,
+// playing, won or lost. reveal lists the cells it revealed in reveal
+// order, with -1 as <touching> of a mine. A board row has a character
+// per cell: # hidden, F flagged, * revealed mine, 0-8 revealed number.
+//
+// Commands can be pipelined: a bot may write many lines before reading.
+// Everything that arrived in one read is answered with a single write,
+// so batches of moves cost one round trip. Sockets and pipes are
+// non-blocking, a bot that doesn't read its replies doesn't hold up
+// the others. Its commands stop being read once Bot::MAX_PENDING bytes
+// of replies wait.
+
+#include "sessions.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Bot {
+    // Longest command accepted, the connection is closed past it
+    constexpr size_t MAX_LINE = 256;
+    constexpr size_t READ_SIZE = 64 * 1024;
+    // Replies kept for a bot that isn't reading before its input is left unread
+    constexpr size_t MAX_PENDING = 1024 * 1024;
+    // Sessions idle this long are evicted to their save encoding
+    constexpr auto IDLE = std::chrono::minutes(5);
+    constexpr int EVICT_INTERVAL_MS = 10000;
+}
+
+struct Connection {
+    int in;
+    int out;
+    // Start of a line that hasn't fully arrived yet
+    std::string input;
+    // Replies not written yet
+    std::string output;
+    // False after end of input or a line too long, the connection
+    // closes once the replies are written
+    bool reading;
+};
+
+static SessionManager sessions;
+static SessionManager::Reply reply;
+static Save::Data board;
+
+static const char *stateName(int state) {
+    if (state & GameState::LOST) return "lost";
+    if (state & GameState::WON) return "won";
+    if (state & GameState::STARTED) return "playing";
+    return "ready";
+}
+
+static void append(std::string& out, const char *fmt, long a, long b = 0, long c = 0) {
+    char buf[64];
+    const int length = snprintf(buf, sizeof(buf), fmt, a, b, c);
+    out.append(buf, length);
+}
+
+// Splits a line into up to `max` words, returns how many there were
+static int split(char *line, char **words, int max) {
+    int count = 0;
+    for (char *word = strtok(line, " \t\r"); word; word = strtok(nullptr, " \t\r")) {
+        if (count == max) return max + 1;
+        words[count++] = word;
+    }
+    return count;
+}
+
+static bool parse(const char *word, long& value) {
+    char *end;
+    // Clamps to LONG_MIN or LONG_MAX on overflow, which no argument accepts
+    value = strtol(word, &end, 10);
+    return *word && !*end;
+}
+
+static void execute(char *line, std::string& out) {
+    char *words[5];
+    const int count = split(line, words, 4);
+    if (count == 0) {
+        out += "err empty command\n";
+        return;
+    }
+
+    long args[3] = { 0, 0, 0 };
+    for (int i = 1; i < count && i < 4; ++i) {
+        if (!parse(words[i], args[i - 1])) {
+            out += "err expected a number\n";
+            return;
+        }
+    }
+
+    // `board` is a query that also sends the cells
+    struct { const char *name; SessionManager::Command::Type type; int args; bool board; } const COMMANDS[] = {
+        { "new",    SessionManager::Command::CREATE, 3, false },
+        { "reveal", SessionManager::Command::CLICK,  3, false },
+        { "flag",   SessionManager::Command::FLAG,   3, false },
+        { "status", SessionManager::Command::QUERY,  1, false },
+        { "board",  SessionManager::Command::QUERY,  1, true },
+        { "close",  SessionManager::Command::CLOSE,  1, false },
+    };
+    const char *name = words[0];
+    auto command = std::find_if(std::begin(COMMANDS), std::end(COMMANDS),
+                                [name](auto& c) { return strcmp(c.name, name) == 0; });
+    if (command == std::end(COMMANDS)) {
+        out += "err unknown command\n";
+        return;
+    }
+    if (count - 1 != command->args) {
+        out += "err wrong number of arguments\n";
+        return;
+    }
+    // Seeds and ids are unsigned 32 bit, everything else an int.
+    // Checked before narrowing, or out of range values would wrap around
+    for (int i = 0; i < command->args; ++i) {
+        const bool isUnsigned = command->type == SessionManager::Command::CREATE ? i == 2 : i == 0;
+        const long low = isUnsigned ? 0 : long(INT_MIN);
+        const long high = isUnsigned ? long(UINT32_MAX) : long(INT_MAX);
+        if (args[i] < low || args[i] > high) {
+            out += "err number out of range\n";
+            return;
+        }
+    }
+
+    if (command->type == SessionManager::Command::CREATE) {
+        sessions.dispatch({ command->type, 0, 0, 0, int(args[0]), int(args[1]), uint32_t(args[2]) }, reply);
+    }
+    else {
+        sessions.dispatch({ command->type, SessionManager::Id(args[0]), int(args[1]), int(args[2]), 0, 0, 0 }, reply);
+    }
+    if (reply.error) {
+        out += "err ";
+        out += reply.error;
+        out += '\n';
+        return;
+    }
+
+    out += "ok";
+    switch (command->type) {
+    case SessionManager::Command::CREATE:
+        append(out, " %ld", reply.session);
+        break;
+    case SessionManager::Command::CLICK:
+        out += ' ';
+        out += stateName(reply.state);
+        append(out, " %ld", reply.flipped.size());
+        for (size_t i = 0; i < reply.flipped.size(); ++i) {
+            append(out, " %ld,%ld,%ld", reply.flipped[i].row, reply.flipped[i].col, reply.touching[i]);
+        }
+        break;
+    case SessionManager::Command::FLAG:
+        out += ' ';
+        out += stateName(reply.state);
+        append(out, " %ld", reply.flags);
+        break;
+    case SessionManager::Command::QUERY:
+        out += ' ';
+        out += stateName(reply.state);
+        if (!command->board) {
+            append(out, " %ld %ld", reply.flags, reply.mines);
+            break;
+        }
+        sessions.board(reply.session, board);
+        append(out, " %ld %ld", board.rows, board.cols);
+        for (int r = 0; r < board.rows; ++r) {
+            out += ' ';
+            for (int c = 0; c < board.cols; ++c) {
+                const uint8_t cell = board.tiles[r*board.cols + c];
+                if (cell & TileSaveData::FLAGGED) out += 'F';
+                else if (cell & TileSaveData::HIDDEN) out += '#';
+                else if (cell & TileSaveData::MINE) out += '*';
+                else {
+                    int touching = 0;
+                    for (int nr = std::max(r - 1, 0); nr <= std::min(r + 1, board.rows - 1); ++nr) {
+                        for (int nc = std::max(c - 1, 0); nc <= std::min(c + 1, board.cols - 1); ++nc) {
+                            touching += (board.tiles[nr*board.cols + nc] & TileSaveData::MINE) != 0;
+                        }
+                    }
+                    out += char('0' + touching);
+                }
+            }
+        }
+        break;
+    case SessionManager::Command::CLOSE:
+        break;
+    }
+    out += '\n';
+}
+
+// Writes as much of the pending replies as fits without blocking.
+// Returns false if the connection failed
+static bool flush(Connection& connection) {
+    size_t done = 0;
+    while (done < connection.output.size()) {
+        const ssize_t written = write(connection.out, connection.output.data() + done,
+                                      connection.output.size() - done);
+        if (written >= 0) done += written;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        else if (errno != EINTR) return false;
+    }
+    connection.output.erase(0, done);
+    return true;
+}
+
+// Runs every complete line that arrived and queues the answers.
+// Returns false if the connection failed
+static bool serve(Connection& connection) {
+    static char buf[Bot::READ_SIZE];
+    const ssize_t size = read(connection.in, buf, sizeof(buf));
+    if (size < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    if (size == 0) {
+        connection.reading = false;
+        return true;
+    }
+    connection.input.append(buf, size);
+
+    size_t start = 0;
+    for (size_t end; (end = connection.input.find('\n', start)) != std::string::npos; start = end + 1) {
+        connection.input[end] = '\0';
+        execute(&connection.input[start], connection.output);
+    }
+    connection.input.erase(0, start);
+
+    if (connection.input.size() > Bot::MAX_LINE) {
+        connection.output += "err line too long\n";
+        connection.reading = false;
+    }
+    return true;
+}
+
+static void setNonBlocking(int fd) {
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("fcntl");
+        exit(1);
+    }
+}
+
+// The flag is on the open file description, which inherited stdio shares
+// with the parent, and stays after exit. Only pipes and sockets get it,
+// a terminal or file is left as it is and served blocking
+static void setStdioNonBlocking(int fd) {
+    struct stat info;
+    if (fstat(fd, &info) == 0 && (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode))) {
+        setNonBlocking(fd);
+    }
+}
+
+static int listenOn(const char *path) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        exit(1);
+    }
+    strcpy(address.sun_path, path);
+    unlink(path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror(path);
+        exit(1);
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+int main(int argc, char **argv) {
+    // A bot that hangs up early shows up as a failed write instead
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = -1;
+    std::vector<Connection> connections;
+    if (argc == 3 && strcmp(argv[1], "--socket") == 0) {
+        listener = listenOn(argv[2]);
+        fprintf(stderr, "Listening on %s\n", argv[2]);
+    }
+    else if (argc == 1) {
+        setStdioNonBlocking(STDIN_FILENO);
+        setStdioNonBlocking(STDOUT_FILENO);
+        connections.push_back({ STDIN_FILENO, STDOUT_FILENO, "", "", true });
+    }
+    else {
+        fprintf(stderr, "Usage: %s [--socket <path>]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<pollfd> fds;
+    auto lastEvict = std::chrono::steady_clock::now();
+    while (listener >= 0 || !connections.empty()) {
+        // Two entries per connection, input then output. poll skips negative fds
+        fds.clear();
+        for (auto& connection : connections) {
+            const bool read = connection.reading && connection.output.size() < Bot::MAX_PENDING;
+            fds.push_back({ read ? connection.in : -1, POLLIN, 0 });
+            fds.push_back({ connection.output.empty() ? -1 : connection.out, POLLOUT, 0 });
+        }
+        if (listener >= 0) fds.push_back({ listener, POLLIN, 0 });
+
+        if (poll(fds.data(), fds.size(), Bot::EVICT_INTERVAL_MS) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return 1;
+        }
+
+        // Backwards so closed connections can be erased on the way
+        for (size_t i = connections.size(); i-- > 0; ) {
+            Connection& connection = connections[i];
+            bool open = true;
+            if (fds[2*i].revents) open = serve(connection);
+            // Replies go out right away, POLLOUT is only waited for when they didn't fit
+            if (open && !connection.output.empty()) open = flush(connection);
+            if (!open || (!connection.reading && connection.output.empty())) {
+                if (listener >= 0) close(connection.in);
+                connections.erase(connections.begin() + i);
+            }
+        }
+        if (listener >= 0 && fds.back().revents & POLLIN) {
+            const int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                setNonBlocking(fd);
+                connections.push_back({ fd, fd, "", "", true });
+            }
+        }
+
+        if (std::chrono::steady_clock::now() - lastEvict > std::chrono::milliseconds(Bot::EVICT_INTERVAL_MS)) {
+            sessions.evictIdle(Bot::IDLE);
+            lastEvict = std::chrono::steady_clock::now();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,416 @@
+// Plays random games against the Minefield and checks its invariants
+// after every move. The same game also runs through a SessionManager,
+// evicted every other move, which must end up on the same board.
+// Failing games are shrunk to a short replay.
+//
+//   minefuzz [games] [threads] [seed]
+//   minefuzz replay <rows> <cols> <seed> [moves...]
+//
+// A move is c<row>,<col> to click a cell or f<row>,<col> to flag it.
+
+#include "minefield.h"
+#include "save.h"
+#include "sessions.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Fuzz {
+    constexpr long DEFAULT_GAMES = 10000;
+    // Games on boards up to this size, the rest on any size
+    constexpr int SMALL_SIZE = 6;
+    constexpr double SMALL_CHANCE = 0.5;
+    constexpr double FLAG_CHANCE = 0.25;
+    // Chance a move picks a hidden cell instead of any cell
+    constexpr double HIDDEN_CHANCE = 0.8;
+    // Moves still played after the game is over
+    constexpr int MOVES_AFTER_OVER = 3;
+}
+
+struct Move {
+    bool flag;
+    int row;
+    int col;
+};
+
+struct Case {
+    int rows;
+    int cols;
+    uint32_t seed;
+    std::vector<Move> moves;
+};
+
+// The part of a failure before the ':', so shrinking doesn't
+// wander off to a different bug
+static std::string kind(const std::string& failure) {
+    return failure.substr(0, failure.find(':'));
+}
+
+static std::string format(const char *fmt, int a, int b = 0, int c = 0) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), fmt, a, b, c);
+    return buf;
+}
+
+static bool operator==(const Save::Data& a, const Save::Data& b) {
+    return a.rows == b.rows && a.cols == b.cols && a.state == b.state
+        && a.seed == b.seed && a.tiles == b.tiles;
+}
+
+// Returns an empty string if all invariants hold
+static std::string check(const Minefield& field, std::mt19937& rng) {
+    const bool started = field.state & GameState::STARTED;
+    const bool won = field.state & GameState::WON;
+    const bool lost = field.state & GameState::LOST;
+    if (won && lost) return "state: both won and lost";
+
+    int flagged = 0;
+    bool allSafeRevealed = true;
+    for (int r = 0; r < field.rows; ++r) {
+        for (int c = 0; c < field.cols; ++c) {
+            flagged += field.isFlagged(r, c);
+
+            if (field.isHidden(r, c) && !field.isMine(r, c)) allSafeRevealed = false;
+
+            if (!started && (field.isMine(r, c) || !field.isHidden(r, c))) {
+                return format("start: cell %d,%d changed before the first click", r, c);
+            }
+            if (!lost && field.isMine(r, c) && !field.isHidden(r, c)) {
+                return format("mines: mine %d,%d revealed without losing", r, c);
+            }
+            if (field.isRemoved(r, c) && !(won && field.isMine(r, c))) {
+                return format("removed: cell %d,%d removed", r, c);
+            }
+
+            int touching = 0;
+            field.foreachTouching(r, c, [&](int nr, int nc) {
+                touching += field.isMine(nr, nc);
+            });
+            if (touching != field.countTouchingMines(r, c)) {
+                return format("numbers: cell %d,%d says %d", r, c, field.countTouchingMines(r, c))
+                     + format(" but touches %d mines", touching);
+            }
+        }
+    }
+    if (flagged != field.flagCount()) {
+        return format("flags: counted %d but %d cells are flagged", field.flagCount(), flagged);
+    }
+    if (won && !allSafeRevealed) return "win: won with safe cells still hidden";
+    if (started && !lost && allSafeRevealed && !won) return "win: all safe cells revealed but not won";
+
+    // Save and load
+    const Save::Data snapshot = field.snapshot();
+    std::vector<uint8_t> bytes = Save::encode(snapshot);
+    Save::Data decoded;
+    if (const char *error = Save::decode(bytes.data(), bytes.size(), decoded)) {
+        return std::string("save: can't decode own save (") + error + ")";
+    }
+    if (!(decoded == snapshot)) return "save: decoded save differs";
+
+    Minefield loaded(0);
+    loaded.restore(decoded);
+    if (!(loaded.snapshot() == snapshot)) return "load: restored board differs";
+    if (loaded.flagCount() != field.flagCount()) return "load: flag count differs";
+    for (int r = 0; r < field.rows; ++r) {
+        for (int c = 0; c < field.cols; ++c) {
+            if (loaded.countTouchingMines(r, c) != field.countTouchingMines(r, c)) {
+                return format("load: numbers differ at %d,%d", r, c);
+            }
+        }
+    }
+
+    // A damaged save is either rejected or still a whole board
+    bytes[rng() % bytes.size()] ^= 1 << (rng() % 8);
+    Save::Data damaged;
+    if (!Save::decode(bytes.data(), bytes.size(), damaged)
+            && damaged.tiles.size() != size_t(damaged.rows * damaged.cols)) {
+        return format("corrupt: accepted save with %d tiles for %dx%d",
+                      int(damaged.tiles.size()), damaged.rows, damaged.cols);
+    }
+
+    // A save claiming a board too large to play is rejected before its
+    // tiles are allocated, even with a valid checksum
+    Save::Data oversized = snapshot;
+    oversized.tiles.clear();
+    int& side = rng() % 2 ? oversized.rows : oversized.cols;
+    side = MAX_FIELD_SIZE + rng() % (0x10000 - MAX_FIELD_SIZE);
+    bytes = Save::encode(oversized);
+    Save::Data huge;
+    if (!Save::decode(bytes.data(), bytes.size(), huge) || !huge.tiles.empty()) {
+        return format("oversized: decoded %d tiles of a %dx%d save", int(huge.tiles.size()), huge.rows, huge.cols);
+    }
+
+    // Same for the legacy format, which has a byte per side
+    const uint8_t legacy[] = { 'M', 'I', 'N', 'E', ' ', 'r', uint8_t(MAX_FIELD_SIZE + rng() % (0x100 - MAX_FIELD_SIZE)),
+                               'c', uint8_t(1 + rng() % 0xFF), 'g', 0, 'z', 0, 0, 0, 0 };
+    if (!Save::decode(legacy, sizeof(legacy), huge) || !huge.tiles.empty()) {
+        return format("oversized: decoded %d tiles of a %dx%d legacy save", int(huge.tiles.size()), huge.rows, huge.cols);
+    }
+    return "";
+}
+
+static void apply(Minefield& field, const Move& move) {
+    std::vector<Minefield::Flip> flipped;
+    if (move.flag) field.toggleFlag(move.row, move.col);
+    else field.click(move.row, move.col, flipped);
+}
+
+static void newGame(Minefield& field, const Case& game) {
+    field.rows = game.rows;
+    field.cols = game.cols;
+    field.seed = game.seed;
+    field.rng.seed(game.seed);
+    field.reset();
+}
+
+// Play the moves of a case, returns the first failure and at which move
+static std::string play(const Case& game, size_t& failedAt, bool verbose = false) {
+    Minefield field(game.seed);
+    newGame(field, game);
+    std::mt19937 rng(game.seed);
+
+    SessionManager sessions;
+    SessionManager::Reply reply;
+    sessions.dispatch({ SessionManager::Command::CREATE, 0, 0, 0, game.rows, game.cols, game.seed }, reply);
+    const SessionManager::Id id = reply.session;
+    Save::Data hosted;
+
+    std::string failure = check(field, rng);
+    for (failedAt = 0; failure.empty() && failedAt < game.moves.size(); ++failedAt) {
+        const Move& move = game.moves[failedAt];
+        apply(field, move);
+        failure = check(field, rng);
+
+        if (failedAt % 2) sessions.evict(id);
+        sessions.dispatch({ move.flag ? SessionManager::Command::FLAG : SessionManager::Command::CLICK,
+                            id, move.row, move.col, 0, 0, 0 }, reply);
+        if (failure.empty() && (!sessions.board(id, hosted) || !(hosted == field.snapshot()))) {
+            failure = "sessions: hosted board differs from the Minefield";
+        }
+        if (failure.empty() && reply.mines != field.mineCount) {
+            failure = format("sessions: hosted board has %d mines, the Minefield %d", reply.mines, field.mineCount);
+        }
+
+        if (verbose) {
+            printf("%c%d,%d state=%d flags=%d/%d\n", move.flag ? 'f' : 'c', move.row, move.col,
+                   field.state, field.flagCount(), field.mineCount);
+            for (int r = 0; r < field.rows; ++r) {
+                for (int c = 0; c < field.cols; ++c) {
+                    char ch = '0' + field.countTouchingMines(r, c);
+                    if (field.isFlagged(r, c)) ch = 'F';
+                    else if (field.isHidden(r, c)) ch = '#';
+                    else if (field.isMine(r, c)) ch = '*';
+                    else if (ch == '0') ch = '.';
+                    putchar(ch);
+                }
+                putchar('\n');
+            }
+        }
+    }
+    if (failure.empty()) failedAt = game.moves.size();
+    else failedAt -= failedAt > 0;
+    return failure;
+}
+
+// Pick moves by looking at the board as it's played
+static Case randomCase(uint32_t seed, long& moveCount) {
+    std::mt19937 rng(seed ^ 0x9E3779B9);
+    auto chance = [&rng](double p) { return std::uniform_real_distribution<>(0.0, 1.0)(rng) < p; };
+
+    Case game;
+    const int maxSize = chance(Fuzz::SMALL_CHANCE) ? Fuzz::SMALL_SIZE : MAX_FIELD_SIZE - 1;
+    game.rows = std::uniform_int_distribution<>(1, maxSize)(rng);
+    game.cols = std::uniform_int_distribution<>(1, maxSize)(rng);
+    game.seed = seed;
+
+    Minefield field(seed);
+    newGame(field, game);
+
+    std::vector<std::pair<int, int>> hidden;
+    int afterOver = 0;
+    const int maxMoves = 2 * game.rows * game.cols + 2;
+    while (int(game.moves.size()) < maxMoves && afterOver < Fuzz::MOVES_AFTER_OVER) {
+        Move move;
+        move.flag = chance(Fuzz::FLAG_CHANCE);
+        move.row = std::uniform_int_distribution<>(0, game.rows - 1)(rng);
+        move.col = std::uniform_int_distribution<>(0, game.cols - 1)(rng);
+
+        if (chance(Fuzz::HIDDEN_CHANCE)) {
+            hidden.clear();
+            for (int r = 0; r < game.rows; ++r) {
+                for (int c = 0; c < game.cols; ++c) {
+                    if (field.isHidden(r, c)) hidden.emplace_back(r, c);
+                }
+            }
+            if (!hidden.empty()) {
+                auto cell = hidden[rng() % hidden.size()];
+                move.row = cell.first;
+                move.col = cell.second;
+            }
+        }
+
+        apply(field, move);
+        game.moves.push_back(move);
+        afterOver += (field.state & GameState::OVER) != 0;
+    }
+    moveCount += game.moves.size();
+    return game;
+}
+
+// Remove moves and board rows/columns while the same kind of failure remains
+static Case shrink(Case game, std::string& failure) {
+    size_t failedAt;
+    const std::string wanted = kind(failure);
+    auto fails = [&](const Case& candidate) {
+        std::string result = play(candidate, failedAt);
+        if (result.empty() || kind(result) != wanted) return false;
+        failure = result;
+        return true;
+    };
+    auto truncate = [&failedAt](Case& candidate) {
+        candidate.moves.resize(std::min(candidate.moves.size(), failedAt + 1));
+    };
+
+    fails(game);
+    truncate(game);
+
+    bool progress = true;
+    while (progress) {
+        progress = false;
+
+        for (size_t chunk = std::max<size_t>(game.moves.size() / 2, 1); chunk > 0; chunk /= 2) {
+            for (size_t i = 0; i < game.moves.size(); ) {
+                Case candidate = game;
+                auto begin = candidate.moves.begin() + i;
+                candidate.moves.erase(begin, begin + std::min(chunk, game.moves.size() - i));
+                if (fails(candidate)) {
+                    truncate(candidate);
+                    game = std::move(candidate);
+                    progress = true;
+                } else {
+                    i += chunk;
+                }
+            }
+        }
+
+        for (int dim = 0; dim < 2; ++dim) {
+            Case candidate = game;
+            int& size = dim == 0 ? candidate.rows : candidate.cols;
+            if (size == 1) continue;
+            size -= 1;
+            candidate.moves.clear();
+            for (auto& move : game.moves) {
+                if (move.row < candidate.rows && move.col < candidate.cols) candidate.moves.push_back(move);
+            }
+            if (fails(candidate)) {
+                truncate(candidate);
+                game = std::move(candidate);
+                progress = true;
+            }
+        }
+    }
+    return game;
+}
+
+static void printReplay(const Case& game) {
+    printf("replay: minefuzz replay %d %d %u", game.rows, game.cols, game.seed);
+    for (auto& move : game.moves) {
+        printf(" %c%d,%d", move.flag ? 'f' : 'c', move.row, move.col);
+    }
+    printf("\n");
+}
+
+static int replay(int argc, char **argv) {
+    if (argc < 5) {
+        fprintf(stderr, "usage: %s replay <rows> <cols> <seed> [moves...]\n", argv[0]);
+        return 1;
+    }
+    Case game;
+    game.rows = atoi(argv[2]);
+    game.cols = atoi(argv[3]);
+    game.seed = strtoul(argv[4], nullptr, 10);
+    if (game.rows < 1 || game.cols < 1 || game.rows >= MAX_FIELD_SIZE || game.cols >= MAX_FIELD_SIZE) {
+        fprintf(stderr, "Board must be between 1x1 and %dx%d\n", MAX_FIELD_SIZE - 1, MAX_FIELD_SIZE - 1);
+        return 1;
+    }
+    for (int i = 5; i < argc; ++i) {
+        Move move;
+        char type;
+        if (sscanf(argv[i], "%c%d,%d", &type, &move.row, &move.col) != 3 || (type != 'c' && type != 'f')
+                || move.row < 0 || move.col < 0 || move.row >= game.rows || move.col >= game.cols) {
+            fprintf(stderr, "Invalid move '%s'\n", argv[i]);
+            return 1;
+        }
+        move.flag = type == 'f';
+        game.moves.push_back(move);
+    }
+
+    size_t failedAt;
+    std::string failure = play(game, failedAt, true);
+    if (failure.empty()) {
+        printf("SUCCEEDED\n");
+        return 0;
+    }
+    printf("FAILED after move %zu: %s\n", failedAt + 1, failure.c_str());
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::string(argv[1]) == "replay") {
+        return replay(argc, argv);
+    }
+
+    const long games = argc > 1 ? atol(argv[1]) : Fuzz::DEFAULT_GAMES;
+    const int threads = argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t baseSeed = argc > 3 ? strtoul(argv[3], nullptr, 10) : time(0);
+    printf("Fuzzing %ld games on %d threads, seed %u\n", games, threads, baseSeed);
+
+    std::atomic<long> next {0};
+    std::atomic<long> moves {0};
+    std::atomic<bool> failed {false};
+    std::mutex reportMutex;
+    Case failing;
+    std::string failure;
+
+    auto start = std::chrono::steady_clock::now();
+    auto worker = [&]() {
+        long moveCount = 0;
+        for (long i; !failed && (i = next++) < games; ) {
+            Case game = randomCase(baseSeed + i, moveCount);
+            size_t failedAt;
+            std::string result = play(game, failedAt);
+            if (!result.empty() && !failed.exchange(true)) {
+                std::lock_guard<std::mutex> lock(reportMutex);
+                failing = std::move(game);
+                failure = result;
+            }
+        }
+        moves += moveCount;
+    };
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) workers.emplace_back(worker);
+    for (auto& thread : workers) thread.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const long played = std::min(next.load(), games);
+    printf("%ld games, %ld moves in %.2f s (%.0f games/s, %.0f moves/s)\n",
+           played, moves.load(), seconds, played / seconds, moves / seconds);
+
+    if (failed) {
+        printf("FAILED: %s\n", failure.c_str());
+        printf("Shrinking %zu moves on %dx%d...\n", failing.moves.size(), failing.rows, failing.cols);
+        failing = shrink(failing, failure);
+        printf("FAILED: %s\n", failure.c_str());
+        printReplay(failing);
+        return 1;
+    }
+    printf("SUCCEEDED\n");
+    return 0;
+}
@@ -1,11 +1,5 @@
 #!/bin/env lua
 
-local tests = {
-    "tests/die",
-    "tests/full",
-    "tests/red",
-}
-
 Exe = function(cmd)
     print("+ "..cmd)
     local success, result, code = os.execute(cmd)
@@ -20,11 +14,14 @@ end
 if not Exe("cmake . -DFRONTEND=TEST -G Ninja && ninja") then
     return io.stderr:write("Could not run tests: Failed to build testminesector\n")
 end
+
+-- Every tests/<name> is a CTest case, run them in parallel while the
+-- cache still has FRONTEND=TEST
+local success, code = Exe("ctest --output-on-failure -j $(getconf _NPROCESSORS_ONLN)")
+if not success then io.stderr:write("Tests failed with code "..code.."\n") end
+
 if not Exe("cmake . -DFRONTEND=NATIVE -G Ninja && ninja") then
     return io.stderr:write("Could not run tests: Failed to build minesector\n")
 end
 
-for _,file_name in ipairs(tests) do
-    local success, code = Exe(string.format("./testminesector run %q", file_name))
-    if not success then io.stderr:write("Test exited with code "..code.."\n") end
-end
+if not success then os.exit(1) end